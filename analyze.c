@@ -0,0 +1,199 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Static program analyzer.
+Prints the control flow graph of a program, which bytes are code and data, and whether the program modifies its own code.
+Exits with 0 if the program is safe to precompile and cache, 2 if it has stores or jumps that could not be resolved, and 3 if it writes to its own code.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cfg.h"
+#include "chip8.h"
+#include "rom.h"
+
+/*
+Function Declarations
+*/
+
+void
+printBlocks(const Cfg *cfg);
+
+void
+printDot(const Cfg *cfg);
+
+void
+printSummary(const Cfg *cfg, const Rom *rom);
+
+/*
+Global Variables
+*/
+
+static const char *Verdicts[] = {
+	"safe", "unresolved", "self-modifying"
+};
+
+/*
+Function Definitions
+*/
+
+void
+printBlocks(const Cfg *cfg)
+{
+	static const char *exits[] = {
+		"fallthrough", "jump", "skip", "call", "return", "indirect", "exit", "off end"
+	};
+
+	printf("blocks: %d\n", cfg->BlockCount);
+
+	for (int i = 0; i < cfg->BlockCount; i++) {
+		const CfgBlock *block = &cfg->Blocks[i];
+
+		printf("  %03X-%03X %-11s", block->Start, block->End - 1, exits[block->Exit]);
+		for (int j = 0; j < block->SuccessorCount; j++) {
+			printf(" %03X", block->Successors[j]);
+		}
+		if (cfg->Flags[block->Start] & CFG_CALL_TARGET) {
+			printf(" (subroutine)");
+		}
+		printf("\n");
+	}
+}
+
+void
+printDot(const Cfg *cfg)
+{
+	printf("digraph program {\n");
+	printf("\tnode [shape=box];\n");
+
+	for (int i = 0; i < cfg->BlockCount; i++) {
+		const CfgBlock *block = &cfg->Blocks[i];
+
+		printf("\tb%03X [label=\"%03X-%03X\"];\n", block->Start, block->Start, block->End - 1);
+		for (int j = 0; j < block->SuccessorCount; j++) {
+			printf("\tb%03X -> b%03X;\n", block->Start, block->Successors[j]);
+		}
+	}
+
+	printf("}\n");
+}
+
+void
+printSummary(const Cfg *cfg, const Rom *rom)
+{
+	int code = 0;
+	int data = 0;
+	int unreached = 0;
+
+	for (unsigned int address = ROM_START; address < ROM_START + rom->Size; address++) {
+		if (cfg->Flags[address] & CFG_CODE) {
+			++code;
+		} else if (cfg->Flags[address] & (CFG_READ | CFG_WRITTEN)) {
+			++data;
+		} else {
+			++unreached;
+		}
+	}
+
+	printf("size: %zu bytes\n", rom->Size);
+	printf("code: %d bytes, data: %d bytes, unreached: %d bytes\n", code, data, unreached);
+
+	printf("stores: %d\n", cfg->StoreCount);
+	for (int i = 0; i < cfg->StoreCount; i++) {
+		const CfgStore *store = &cfg->Stores[i];
+		const char *name = (store->Opcode & 0xFF) == 0x33 ? "bcd" : "save";
+
+		if (store->Length == 0) {
+			printf("  %03X %04X %-4s to unknown I\n", store->Address, store->Opcode, name);
+		} else {
+			printf("  %03X %04X %-4s to %03X-%03X%s\n", store->Address, store->Opcode, name,
+				store->Start, store->Start + store->Length - 1, store->IntoCode ? " which is code" : "");
+		}
+	}
+
+	printf("unresolved jumps: %d\n", cfg->IndirectCount);
+	for (int i = 0; i < cfg->IndirectCount; i++) {
+		printf("  %03X %04X jump %03X, v0\n", cfg->Indirects[i].Address, cfg->Indirects[i].Opcode, cfg->Indirects[i].Opcode & 0xFFF);
+	}
+
+	printf("verdict: %s\n", Verdicts[cfgVerdict(cfg)]);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static unsigned char memory[CFG_MEMORY_SIZE];
+	int dot = 0;
+	int quiet = 0;
+	int quirks = QUIRKS_DEFAULT;
+	int option;
+	int status;
+	Rom rom;
+	Cfg cfg;
+
+	while ((option = getopt(argc, argv, "dq:s")) != -1) {
+		switch (option) {
+		case 'd':
+			dot = 1;
+			break;
+		case 'q':
+			quirks = chip8FindQuirks(optarg);
+			if (quirks == -1) {
+				printf("Unknown quirk profile %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 's':
+			quiet = 1;
+			break;
+		default:
+			printf("usage: %s [-d] [-s] [-q profile] program\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc - 1) {
+		printf("Please specify one program file\n");
+		return 1;
+	}
+
+	status = romOpen(&rom, argv[optind]);
+	if (status != ROM_OK) {
+		printf("%s: %s\n", argv[optind], romError(&rom, status));
+		return 1;
+	}
+
+	romLoad(&rom, memory);
+
+	if (cfgBuild(&cfg, memory, quirks) != 0) {
+		printf("Out of memory\n");
+		return 1;
+	}
+
+	if (dot) {
+		printDot(&cfg);
+	} else if (quiet) {
+		printf("%s: %s\n", argv[optind], Verdicts[cfgVerdict(&cfg)]);
+	} else {
+		printBlocks(&cfg);
+		printSummary(&cfg, &rom);
+	}
+
+	status = cfgVerdict(&cfg);
+
+	cfgFree(&cfg);
+	romClose(&rom);
+
+	switch (status) {
+	case CFG_UNRESOLVED:
+		return 2;
+	case CFG_SELF_MODIFYING:
+		return 3;
+	}
+
+	return 0;
+}
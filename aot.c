@@ -0,0 +1,502 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Ahead of time translator.
+Translates a program into a C file with a label for every basic block found by cfgBuild, calling the opcode functions of chip8.c for every instruction.
+The generated file includes chip8.c and defines aotRun, so it is built in place of chip8.c with -DAOT.
+Jumps and returns whose target is not known until run time go through a switch on the program counter, falling back to the interpreter for addresses that were not precompiled.
+Stores into precompiled code are caught at run time, after which the program is interpreted.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cfg.h"
+#include "chip8.h"
+#include "rom.h"
+
+/*
+Function Declarations
+*/
+
+void
+emitGoto(FILE *out, const Cfg *cfg, unsigned int address, const char *indent);
+
+void
+emitSkip(FILE *out, const Cfg *cfg, unsigned short address, const char *call);
+
+int
+emitInstruction(FILE *out, const Cfg *cfg, unsigned short address, unsigned short opcode);
+
+void
+emitProgram(FILE *out, const Cfg *cfg, const unsigned char *memory, const char *name);
+
+/*
+Function Definitions
+*/
+
+/*
+Jumps to the block at address, or through the dispatch switch if there is none.
+*/
+void
+emitGoto(FILE *out, const Cfg *cfg, unsigned int address, const char *indent)
+{
+	if (address < CFG_MEMORY_SIZE && cfgBlockAt(cfg, address) != NULL) {
+		fprintf(out, "%sgoto block%03X;\n", indent, address);
+	} else {
+		fprintf(out, "%sstate->ProgramCounter = 0x%03X;\n", indent, address);
+		fprintf(out, "%sgoto dispatch;\n", indent);
+	}
+}
+
+/*
+Skips are run through their opcode function, which moves the program counter past the next instruction when they skip.
+*/
+void
+emitSkip(FILE *out, const Cfg *cfg, unsigned short address, const char *call)
+{
+	fprintf(out, "\tstate->ProgramCounter = 0x%03X;\n", address);
+	fprintf(out, "\t%s;\n", call);
+	fprintf(out, "\tif (state->ProgramCounter != 0x%03X) {\n", address);
+	emitGoto(out, cfg, address + 4, "\t\t");
+	fprintf(out, "\t}\n");
+	emitGoto(out, cfg, address + 2, "\t");
+}
+
+/*
+Emits one instruction, mirroring the opcode switch in runTicks.
+Returns non zero if the instruction transferred control, else the caller falls through to the next one.
+*/
+int
+emitInstruction(FILE *out, const Cfg *cfg, unsigned short address, unsigned short opcode)
+{
+	char call[64];
+	unsigned int x = (opcode & 0xF00) >> 8;
+	unsigned int y = (opcode & 0xF0) >> 4;
+	unsigned int n = opcode & 0xF;
+	unsigned int kk = opcode & 0xFF;
+	unsigned int nnn = opcode & 0xFFF;
+
+	call[0] = '\0';
+
+	fprintf(out, "\t/* %03X: %04X */\n", address, opcode);
+	fprintf(out, "\tTICK(0x%03X);\n", address);
+
+	switch (opcode & 0xF000) {
+	case 0x0000:
+		if (opcode & 0xF00) {
+			emitGoto(out, cfg, nnn, "\t");
+			return 1;
+		}
+
+		switch (opcode & 0xF0) {
+		case 0x10:
+			fprintf(out, "\tstate->ProgramCounter = 0x%03X;\n", address);
+			fprintf(out, "\t*executed = ticks - budget;\n");
+			fprintf(out, "\tstate->Instructions += *executed;\n");
+			fprintf(out, "\treturn programExitValue(state, 0x%X);\n", n);
+			return 1;
+		case 0xC0:
+			snprintf(call, sizeof(call), "scrollDownN(state, 0x%X)", n);
+			break;
+		case 0xE0:
+			if (n == 0x0) {
+				snprintf(call, sizeof(call), "clearScreen(state)");
+			} else if (n == 0xE) {
+				fprintf(out, "\tsubroutineReturn(state);\n");
+				fprintf(out, "\tstate->ProgramCounter += 2;\n");
+				fprintf(out, "\tgoto dispatch;\n");
+				return 1;
+			}
+			break;
+		case 0xF0:
+			switch (n) {
+			case 0xA:
+				snprintf(call, sizeof(call), "compatability(state)");
+				break;
+			case 0xB:
+				snprintf(call, sizeof(call), "scrollRight(state)");
+				break;
+			case 0xC:
+				snprintf(call, sizeof(call), "scrollLeft(state)");
+				break;
+			case 0xD:
+				fprintf(out, "\tstate->ProgramCounter = 0x%03X;\n", address);
+				fprintf(out, "\t*executed = ticks - budget;\n");
+				fprintf(out, "\tstate->Instructions += *executed;\n");
+				fprintf(out, "\treturn programExit(state);\n");
+				return 1;
+			case 0xE:
+				snprintf(call, sizeof(call), "displayBufferLow(state)");
+				break;
+			case 0xF:
+				snprintf(call, sizeof(call), "displayBufferHigh(state)");
+				break;
+			}
+			break;
+		}
+		break;
+	case 0x1000:
+		fprintf(out, "\tstate->ProgramCounter = 0x%03X;\n", address);
+		fprintf(out, "\tcall(state, 0x%03X);\n", nnn);
+		emitGoto(out, cfg, nnn, "\t");
+		return 1;
+	case 0x3000:
+		if (n == 0) {
+			snprintf(call, sizeof(call), "skipEqvXvY(state, 0x%X, 0x%X)", x, y);
+		} else {
+			snprintf(call, sizeof(call), "skipEqvXValue(state, 0x%X, 0x%02X)", x, kk);
+		}
+		emitSkip(out, cfg, address, call);
+		return 1;
+	case 0x4000:
+		snprintf(call, sizeof(call), "skipNevXValue(state, 0x%X, 0x%02X)", x, kk);
+		emitSkip(out, cfg, address, call);
+		return 1;
+	case 0x6000:
+		snprintf(call, sizeof(call), "loadvXValue(state, 0x%X, 0x%02X)", x, kk);
+		break;
+	case 0x7000:
+		snprintf(call, sizeof(call), "addvXValue(state, 0x%X, 0x%02X)", x, kk);
+		break;
+	case 0x8000:
+		switch (n) {
+		case 0x0:
+			snprintf(call, sizeof(call), "loadvXvY(state, 0x%X, 0x%X)", x, y);
+			break;
+		case 0x1:
+			snprintf(call, sizeof(call), "orvXvY(state, 0x%X, 0x%X)", x, y);
+			break;
+		case 0x2:
+			snprintf(call, sizeof(call), "andvXvY(state, 0x%X, 0x%X)", x, y);
+			break;
+		case 0x3:
+			snprintf(call, sizeof(call), "xorvXvY(state, 0x%X, 0x%X)", x, y);
+			break;
+		case 0x4:
+			snprintf(call, sizeof(call), "addvXvY(state, 0x%X, 0x%X)", x, y);
+			break;
+		case 0x5:
+			snprintf(call, sizeof(call), "subvXvY(state, 0x%X, 0x%X)", x, y);
+			break;
+		case 0x6:
+			snprintf(call, sizeof(call), "shrvX(state, 0x%X, 0x%X)", x, y);
+			break;
+		case 0x7:
+			snprintf(call, sizeof(call), "difvXvY(state, 0x%X, 0x%X)", x, y);
+			break;
+		case 0xE:
+			snprintf(call, sizeof(call), "shlvX(state, 0x%X, 0x%X)", x, y);
+			break;
+		}
+		break;
+	case 0x9000:
+		snprintf(call, sizeof(call), "skipNevXvY(state, 0x%X, 0x%X)", x, y);
+		emitSkip(out, cfg, address, call);
+		return 1;
+	case 0xA000:
+		snprintf(call, sizeof(call), "loadI(state, 0x%03X)", nnn);
+		break;
+	case 0xB000:
+		fprintf(out, "\tjumpv0(state, 0x%03X);\n", nnn);
+		fprintf(out, "\tstate->ProgramCounter += 2;\n");
+		fprintf(out, "\tgoto dispatch;\n");
+		return 1;
+	case 0xC000:
+		snprintf(call, sizeof(call), "rndvXMask(state, 0x%X, 0x%02X)", x, kk);
+		break;
+	case 0xD000:
+		if (n == 0) {
+			fprintf(out, "\tdrawvXvY(state, 0x%X, 0x%X);\n", x, y);
+		} else {
+			fprintf(out, "\tdrawvXvYRows(state, 0x%X, 0x%X, 0x%X);\n", x, y, n);
+		}
+		/*
+		runTicks falls through from draw into the key skips.
+		*/
+		if (kk == 0x9E) {
+			snprintf(call, sizeof(call), "skipvXKey(state, 0x%X)", x);
+			emitSkip(out, cfg, address, call);
+			return 1;
+		} else if (kk == 0xA1) {
+			snprintf(call, sizeof(call), "skipNevXKey(state, 0x%X)", x);
+			emitSkip(out, cfg, address, call);
+			return 1;
+		}
+		break;
+	case 0xE000:
+		if (kk == 0x9E) {
+			snprintf(call, sizeof(call), "skipvXKey(state, 0x%X)", x);
+			emitSkip(out, cfg, address, call);
+			return 1;
+		} else if (kk == 0xA1) {
+			snprintf(call, sizeof(call), "skipNevXKey(state, 0x%X)", x);
+			emitSkip(out, cfg, address, call);
+			return 1;
+		}
+		break;
+	case 0xF000:
+		switch (kk) {
+		case 0x07:
+			snprintf(call, sizeof(call), "loadvXTime(state, 0x%X)", x);
+			break;
+		case 0x0A:
+			/*
+			Waiting for a key uses up the rest of the frame, as it does in runTicks.
+			*/
+			fprintf(out, "\tloadvXKey(state, 0x%X);\n", x);
+			fprintf(out, "\tif (state->WaitingForKeyPress) {\n");
+			fprintf(out, "\t\tstate->ProgramCounter = 0x%03X;\n", address);
+			fprintf(out, "\t\tbudget = 0;\n");
+			fprintf(out, "\t\tgoto out;\n");
+			fprintf(out, "\t}\n");
+			break;
+		case 0x15:
+			snprintf(call, sizeof(call), "loadTimevX(state, 0x%X)", x);
+			break;
+		case 0x18:
+			fprintf(out, "\tloadTonevX(state, 0x%X);\n", x);
+			fprintf(out, "\tstate->ProgramCounter = 0x%03X;\n", address + 2);
+			fprintf(out, "\tgoto out;\n");
+			return 1;
+		case 0x1E:
+			snprintf(call, sizeof(call), "addIvX(state, 0x%X)", x);
+			break;
+		case 0x29:
+			snprintf(call, sizeof(call), "hexvX(state, 0x%X)", x);
+			break;
+		case 0x33:
+		case 0x55:
+			fprintf(out, "\tcheckStore(state, %u);\n", kk == 0x33 ? 3 : x + 1);
+			fprintf(out, "\t%s(state, 0x%X);\n", kk == 0x33 ? "bcdvX" : "savevX", x);
+			fprintf(out, "\tif (Stale) {\n");
+			fprintf(out, "\t\tstate->ProgramCounter = 0x%03X;\n", address + 2);
+			fprintf(out, "\t\tgoto out;\n");
+			fprintf(out, "\t}\n");
+			break;
+		case 0x65:
+			snprintf(call, sizeof(call), "restorevX(state, 0x%X)", x);
+			break;
+		}
+		break;
+	}
+
+	if (call[0] != '\0') {
+		fprintf(out, "\t%s;\n", call);
+	}
+
+	return 0;
+}
+
+void
+emitProgram(FILE *out, const Cfg *cfg, const unsigned char *memory, const char *name)
+{
+	unsigned int end;
+
+	fprintf(out, "/*\n");
+	fprintf(out, "Generated by aot from %s.\n", name);
+	fprintf(out, "Build in place of chip8.c with -DAOT.\n");
+	fprintf(out, "*/\n\n");
+	fprintf(out, "#include \"chip8.c\"\n\n");
+
+	fprintf(out, "#define TICK(address) \\\n");
+	fprintf(out, "\tif (budget == 0) { \\\n");
+	fprintf(out, "\t\tstate->ProgramCounter = (address); \\\n");
+	fprintf(out, "\t\tgoto out; \\\n");
+	fprintf(out, "\t} \\\n");
+	fprintf(out, "\t--budget;\n\n");
+
+	fprintf(out, "/*\n");
+	fprintf(out, "Set once any machine stores into precompiled code, after which every machine is interpreted.\n");
+	fprintf(out, "*/\n");
+	fprintf(out, "static int Stale;\n\n");
+
+	if (cfg->StoreCount > 0) {
+		/*
+		One bit per precompiled byte.
+		*/
+		fprintf(out, "static const unsigned char Code[0x%X] = {", CFG_MEMORY_SIZE / 8);
+		for (unsigned int i = 0; i < CFG_MEMORY_SIZE / 8; i++) {
+			unsigned char bits = 0;
+
+			for (unsigned int j = 0; j < 8; j++) {
+				if (cfg->Flags[i * 8 + j] & CFG_CODE) {
+					bits |= 1 << j;
+				}
+			}
+
+			fprintf(out, "%s0x%02X,", i % 12 == 0 ? "\n\t" : " ", bits);
+		}
+		fprintf(out, "\n};\n\n");
+
+		fprintf(out, "static void\n");
+		fprintf(out, "checkStore(State *state, unsigned int length)\n");
+		fprintf(out, "{\n");
+		fprintf(out, "\tfor (unsigned int address = state->I; address < state->I + length && address < 0x%X; address++) {\n", CFG_MEMORY_SIZE);
+		fprintf(out, "\t\tif (Code[address >> 3] & (1 << (address & 7))) {\n");
+		fprintf(out, "\t\t\tStale = 1;\n");
+		fprintf(out, "\t\t}\n");
+		fprintf(out, "\t}\n");
+		fprintf(out, "}\n\n");
+	}
+
+	/*
+	The interpreter fallback stores without checkStore, so the precompiled bytes are kept to compare against after it runs.
+	*/
+	end = ROM_START;
+	for (int i = 0; i < cfg->BlockCount; i++) {
+		if (cfg->Blocks[i].End > end) {
+			end = cfg->Blocks[i].End;
+		}
+	}
+
+	fprintf(out, "static const unsigned char Image[0x%X] = {", end - ROM_START);
+	for (unsigned int address = ROM_START; address < end; address++) {
+		fprintf(out, "%s0x%02X,", (address - ROM_START) % 12 == 0 ? "\n\t" : " ", memory[address]);
+	}
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "static const unsigned short Blocks[%d][2] = {\n", cfg->BlockCount);
+	for (int i = 0; i < cfg->BlockCount; i++) {
+		fprintf(out, "\t{ 0x%03X, 0x%03X },\n", cfg->Blocks[i].Start, cfg->Blocks[i].End);
+	}
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "static void\n");
+	fprintf(out, "checkCode(State *state)\n");
+	fprintf(out, "{\n");
+	fprintf(out, "\tfor (int i = 0; i < %d; i++) {\n", cfg->BlockCount);
+	fprintf(out, "\t\tfor (unsigned short address = Blocks[i][0]; address < Blocks[i][1]; address++) {\n");
+	fprintf(out, "\t\t\tif (readMemory(state, address) != Image[address - 0x%X]) {\n", ROM_START);
+	fprintf(out, "\t\t\t\tStale = 1;\n");
+	fprintf(out, "\t\t\t}\n");
+	fprintf(out, "\t\t}\n");
+	fprintf(out, "\t}\n");
+	fprintf(out, "}\n\n");
+
+	fprintf(out, "int\n");
+	fprintf(out, "aotRun(State *state, int ticks, int *executed)\n");
+	fprintf(out, "{\n");
+	fprintf(out, "\tint budget = ticks;\n");
+	fprintf(out, "\tint status;\n\n");
+	fprintf(out, "\tif (Stale) {\n");
+	fprintf(out, "\t\treturn runTicks(state, ticks, executed);\n");
+	fprintf(out, "\t}\n\n");
+
+	fprintf(out, "dispatch:\n");
+	fprintf(out, "\tswitch (state->ProgramCounter) {\n");
+	for (int i = 0; i < cfg->BlockCount; i++) {
+		fprintf(out, "\tcase 0x%03X:\n", cfg->Blocks[i].Start);
+		fprintf(out, "\t\tgoto block%03X;\n", cfg->Blocks[i].Start);
+	}
+	fprintf(out, "\tdefault:\n");
+	fprintf(out, "\t\tstatus = runTicks(state, budget, executed);\n");
+	fprintf(out, "\t\tcheckCode(state);\n");
+	fprintf(out, "\t\tstate->Instructions += ticks - budget;\n");
+	fprintf(out, "\t\t*executed += ticks - budget;\n");
+	fprintf(out, "\t\treturn status;\n");
+	fprintf(out, "\t}\n");
+
+	for (int i = 0; i < cfg->BlockCount; i++) {
+		const CfgBlock *block = &cfg->Blocks[i];
+		int transferred = 0;
+
+		fprintf(out, "\nblock%03X:\n", block->Start);
+
+		for (unsigned int address = block->Start; address < block->End; address += 2) {
+			transferred = emitInstruction(out, cfg, address, (memory[address] << 8) | memory[address + 1]);
+		}
+
+		if (!transferred) {
+			emitGoto(out, cfg, block->End, "\t");
+		}
+	}
+
+	fprintf(out, "\nout:\n");
+	fprintf(out, "\t*executed = ticks - budget;\n");
+	fprintf(out, "\tstate->Instructions += *executed;\n\n");
+	fprintf(out, "\treturn -1;\n");
+	fprintf(out, "}\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+	static unsigned char memory[CFG_MEMORY_SIZE];
+	const char *outputPath = NULL;
+	FILE *out = stdout;
+	int quirks = QUIRKS_DEFAULT;
+	int option;
+	int status;
+	Rom rom;
+	Cfg cfg;
+
+	while ((option = getopt(argc, argv, "o:q:")) != -1) {
+		switch (option) {
+		case 'o':
+			outputPath = optarg;
+			break;
+		case 'q':
+			quirks = chip8FindQuirks(optarg);
+			if (quirks == -1) {
+				printf("Unknown quirk profile %s\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			printf("usage: %s [-o output.c] [-q profile] program\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc - 1) {
+		printf("Please specify one program file\n");
+		return 1;
+	}
+
+	status = romOpen(&rom, argv[optind]);
+	if (status != ROM_OK) {
+		fprintf(stderr, "%s: %s\n", argv[optind], romError(&rom, status));
+		return 1;
+	}
+
+	romLoad(&rom, memory);
+
+	if (cfgBuild(&cfg, memory, quirks) != 0) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	switch (cfgVerdict(&cfg)) {
+	case CFG_UNRESOLVED:
+		fprintf(stderr, "%s: Warning: some jumps are only resolved at run time and will be interpreted\n", argv[optind]);
+		break;
+	case CFG_SELF_MODIFYING:
+		fprintf(stderr, "%s: Warning: program writes to its own code and will be interpreted once it does\n", argv[optind]);
+		break;
+	}
+
+	if (outputPath != NULL) {
+		out = fopen(outputPath, "w");
+		if (out == NULL) {
+			fprintf(stderr, "Could not open %s\n", outputPath);
+			return 1;
+		}
+	}
+
+	emitProgram(out, &cfg, memory, argv[optind]);
+
+	status = 0;
+	if (outputPath != NULL && fclose(out) != 0) {
+		fprintf(stderr, "Could not write %s\n", outputPath);
+		status = 1;
+	}
+
+	cfgFree(&cfg);
+	romClose(&rom);
+
+	return status;
+}
@@ -0,0 +1,275 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Assembler and disassembler.
+Assembles text with one instruction per line into a program, or with -d writes a program back out as text that assembles to the same bytes.
+Lines may start with a label, "name:", and everything after a ; is a comment.
+Besides the instructions, "data" stores any 16 bit number and "byte" a single byte.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "disasm.h"
+#include "rom.h"
+
+/*
+Lines of a source file, and labels in a program.
+*/
+#define MAX_LINE 256
+#define MAX_LABELS 1024
+
+/*
+Function Declarations
+*/
+
+char *
+stripLine(char *line, char **label);
+
+int
+assembleFile(const char *input, const char *output);
+
+int
+disassembleFile(const char *input, const char *output);
+
+/*
+Global Variables
+*/
+
+static Label Labels[MAX_LABELS];
+static int LabelCount = 0;
+
+/*
+Function Definitions
+*/
+
+/*
+Cuts the comment off line and sets label to its label, or NULL if it has none.
+Returns the instruction left, which is empty if there is none.
+*/
+char *
+stripLine(char *line, char **label)
+{
+	char *comment = strchr(line, ';');
+	char *colon;
+	char *end;
+
+	if (comment != NULL) {
+		*comment = '\0';
+	}
+
+	*label = NULL;
+	while (isspace((unsigned char)*line)) {
+		++line;
+	}
+
+	colon = strchr(line, ':');
+	if (colon != NULL) {
+		*colon = '\0';
+		*label = line;
+		line = colon + 1;
+		while (isspace((unsigned char)*line)) {
+			++line;
+		}
+	}
+
+	end = line + strlen(line);
+	while (end > line && isspace((unsigned char)end[-1])) {
+		*--end = '\0';
+	}
+
+	return line;
+}
+
+/*
+Finds every label on a first pass and assembles on a second, so labels can be used before they are defined.
+Returns 0 on success, -1 after printing the first error.
+*/
+int
+assembleFile(const char *input, const char *output)
+{
+	unsigned char program[ROM_MAX_SIZE];
+	char line[MAX_LINE];
+	FILE *source = fopen(input, "r");
+	FILE *rom;
+	size_t size = 0;
+
+	if (source == NULL) {
+		printf("%s: could not open\n", input);
+		return -1;
+	}
+
+	for (int pass = 0; pass < 2; pass++) {
+		int number = 0;
+
+		rewind(source);
+		size = 0;
+
+		while (fgets(line, sizeof(line), source) != NULL) {
+			char *label;
+			char *text = stripLine(line, &label);
+			unsigned short opcode;
+
+			++number;
+
+			if (pass == 0 && label != NULL) {
+				if (LabelCount == MAX_LABELS || strlen(label) >= sizeof(Labels[0].Name)) {
+					printf("%s:%d: too many labels or label too long\n", input, number);
+					fclose(source);
+					return -1;
+				}
+				for (int i = 0; i < LabelCount; i++) {
+					if (strcmp(Labels[i].Name, label) == 0) {
+						printf("%s:%d: label \"%s\" already defined\n", input, number, label);
+						fclose(source);
+						return -1;
+					}
+				}
+				strcpy(Labels[LabelCount].Name, label);
+				Labels[LabelCount++].Address = ROM_START + size;
+			}
+
+			if (*text == '\0') {
+				continue;
+			}
+
+			if (strncmp(text, "byte", 4) == 0 && isspace((unsigned char)text[4])) {
+				char *start = text + 5;
+				char *end;
+				unsigned long value;
+
+				while (isspace((unsigned char)*start)) {
+					++start;
+				}
+				value = strtoul(start, &end, 0);
+				while (isspace((unsigned char)*end)) {
+					++end;
+				}
+
+				if (!isdigit((unsigned char)*start) || *end != '\0') {
+					printf("%s:%d: byte is not a number\n", input, number);
+					fclose(source);
+					return -1;
+				}
+				if (size == ROM_MAX_SIZE || value > 0xFF) {
+					printf("%s:%d: byte out of range\n", input, number);
+					fclose(source);
+					return -1;
+				}
+				program[size++] = value;
+				continue;
+			}
+
+			if (size + 2 > ROM_MAX_SIZE) {
+				printf("%s:%d: program too large\n", input, number);
+				fclose(source);
+				return -1;
+			}
+
+			if (pass == 1) {
+				if (assemble(text, Labels, LabelCount, &opcode) != 0) {
+					printf("%s:%d: cannot assemble \"%s\"\n", input, number, text);
+					fclose(source);
+					return -1;
+				}
+				program[size] = opcode >> 8;
+				program[size + 1] = opcode;
+			}
+			size += 2;
+		}
+	}
+
+	fclose(source);
+
+	rom = fopen(output, "wb");
+	if (rom == NULL || fwrite(program, 1, size, rom) != size || fclose(rom) != 0) {
+		printf("%s: could not write\n", output);
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+disassembleFile(const char *input, const char *output)
+{
+	FILE *text = fopen(output, "w");
+	Rom rom;
+	int status = romOpen(&rom, input);
+
+	if (status != ROM_OK) {
+		printf("%s: %s\n", input, romError(&rom, status));
+		return -1;
+	}
+
+	if (text == NULL) {
+		printf("%s: could not open\n", output);
+		romClose(&rom);
+		return -1;
+	}
+
+	for (size_t i = 0; i < rom.Size; i += 2) {
+		unsigned short opcode;
+		unsigned short check;
+		char line[32];
+
+		if (i + 1 == rom.Size) {
+			fprintf(text, "\tbyte 0x%02X\t; %03zX\n", rom.Data[i], ROM_START + i);
+			break;
+		}
+
+		opcode = rom.Data[i] << 8 | rom.Data[i + 1];
+		disassemble(opcode, line, sizeof(line));
+
+		/*
+		Every line has to assemble back to the bytes it came from, anything that does not is written as data.
+		*/
+		if (assemble(line, NULL, 0, &check) != 0 || check != opcode) {
+			snprintf(line, sizeof(line), "data 0x%04X", opcode);
+		}
+		fprintf(text, "\t%s\t; %03zX\n", line, ROM_START + i);
+	}
+
+	romClose(&rom);
+
+	if (fclose(text) != 0) {
+		printf("%s: could not write\n", output);
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int reverse = 0;
+	int option;
+
+	while ((option = getopt(argc, argv, "d")) != -1) {
+		switch (option) {
+		case 'd':
+			reverse = 1;
+			break;
+		default:
+			printf("usage: %s [-d] input output\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc - 2) {
+		printf("Please specify an input and an output file\n");
+		return 1;
+	}
+
+	if (reverse) {
+		return disassembleFile(argv[optind], argv[optind + 1]) == 0 ? 0 : 1;
+	}
+
+	return assembleFile(argv[optind], argv[optind + 1]) == 0 ? 0 : 1;
+}
@@ -0,0 +1,302 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio.h"
+
+/*
+Function Declarations
+*/
+
+static void
+ringWrite(ToneRing *ring, const short *samples, unsigned int count);
+
+static void
+writeLe16(unsigned char *bytes, unsigned int value);
+
+static void
+writeLe32(unsigned char *bytes, unsigned long value);
+
+/*
+Function Definitions
+*/
+
+/*
+Copies count samples into the ring buffer.
+The caller must have checked that there is room for them.
+*/
+static void
+ringWrite(ToneRing *ring, const short *samples, unsigned int count)
+{
+	unsigned int head = ring->Head;
+
+	for (unsigned int i = 0; i < count; i++) {
+		ring->Samples[(head + i) & (ring->Size - 1)] = samples[i];
+	}
+
+	/*
+	Publish the samples to the consumer.
+	*/
+	__atomic_store_n(&ring->Head, head + count, __ATOMIC_RELEASE);
+}
+
+static void
+writeLe16(unsigned char *bytes, unsigned int value)
+{
+	bytes[0] = value & 0xFF;
+	bytes[1] = (value >> 8) & 0xFF;
+}
+
+static void
+writeLe32(unsigned char *bytes, unsigned long value)
+{
+	bytes[0] = value & 0xFF;
+	bytes[1] = (value >> 8) & 0xFF;
+	bytes[2] = (value >> 16) & 0xFF;
+	bytes[3] = (value >> 24) & 0xFF;
+}
+
+int
+toneInit(Tone *tone, unsigned int sampleRate, unsigned int framesPerSecond, unsigned int bufferFrames)
+{
+	memset(tone, 0, sizeof(*tone));
+
+	if (bufferFrames == 0 || bufferFrames > TONE_MAX_BUFFER_FRAMES || framesPerSecond == 0) {
+		return -1;
+	}
+
+	tone->SampleRate = sampleRate;
+	tone->FramesPerSecond = framesPerSecond;
+	tone->Frequency = 440;
+	tone->Volume = 0x2000;
+
+	/*
+	Room for two device buffers and two frames keeps latency low while letting the producer run a frame ahead.
+	*/
+	unsigned int needed = 2 * (bufferFrames + sampleRate / framesPerSecond + 1);
+
+	tone->Ring.Size = 1;
+	while (tone->Ring.Size < needed) {
+		tone->Ring.Size <<= 1;
+	}
+
+	tone->Ring.Samples = calloc(tone->Ring.Size, sizeof(short));
+	if (tone->Ring.Samples == NULL) {
+		return -1;
+	}
+
+	return 0;
+}
+
+void
+toneFree(Tone *tone)
+{
+	free(tone->Ring.Samples);
+	tone->Ring.Samples = NULL;
+}
+
+void
+toneEdge(Tone *tone, int on, unsigned int tick)
+{
+	if (tone->EdgeCount == TONE_MAX_EDGES) {
+		--tone->EdgeCount;
+	}
+
+	tone->EdgeTick[tone->EdgeCount] = tick;
+	tone->EdgeGate[tone->EdgeCount] = on;
+	++tone->EdgeCount;
+}
+
+unsigned int
+toneEndFrame(Tone *tone, unsigned int ticks)
+{
+	short samples[1024];
+	unsigned int sampleCount;
+	unsigned int written = 0;
+	unsigned int pushed = 0;
+	unsigned int edge = 0;
+	int gate = tone->Gate;
+
+	/*
+	Spread the remainder of SampleRate / FramesPerSecond over frames so no drift builds up.
+	*/
+	sampleCount = tone->SampleRate / tone->FramesPerSecond;
+	tone->SampleRemainder += tone->SampleRate % tone->FramesPerSecond;
+	if (tone->SampleRemainder >= tone->FramesPerSecond) {
+		tone->SampleRemainder -= tone->FramesPerSecond;
+		++sampleCount;
+	}
+
+	unsigned int tail = __atomic_load_n(&tone->Ring.Tail, __ATOMIC_ACQUIRE);
+	unsigned int room = tone->Ring.Size - (tone->Ring.Head - tail);
+
+	for (unsigned int i = 0; i < sampleCount; i++) {
+		/*
+		Apply every edge that falls on or before this sample.
+		*/
+		while (edge < tone->EdgeCount && (unsigned long)tone->EdgeTick[edge] * sampleCount <= (unsigned long)i * ticks) {
+			if (tone->EdgeGate[edge] && !gate) {
+				tone->Phase = 0;
+			}
+			gate = tone->EdgeGate[edge];
+			++edge;
+		}
+
+		if (gate) {
+			samples[written] = tone->Phase < tone->SampleRate / 2 ? tone->Volume : -tone->Volume;
+			tone->Phase += tone->Frequency;
+			if (tone->Phase >= tone->SampleRate) {
+				tone->Phase -= tone->SampleRate;
+			}
+		} else {
+			samples[written] = 0;
+		}
+		++written;
+
+		if (written == sizeof(samples) / sizeof(samples[0]) || i + 1 == sampleCount) {
+			if (written > room) {
+				tone->Overruns += written - room;
+				written = room;
+			}
+			ringWrite(&tone->Ring, samples, written);
+			room -= written;
+			pushed += written;
+			written = 0;
+		}
+	}
+
+	/*
+	Edges at the end of the frame take effect from the start of the next one.
+	*/
+	while (edge < tone->EdgeCount) {
+		gate = tone->EdgeGate[edge++];
+	}
+
+	tone->Gate = gate;
+	tone->EdgeCount = 0;
+
+	return pushed;
+}
+
+unsigned int
+toneRead(Tone *tone, short *samples, unsigned int count)
+{
+	ToneRing *ring = &tone->Ring;
+	unsigned int tail = ring->Tail;
+	unsigned int available = __atomic_load_n(&ring->Head, __ATOMIC_ACQUIRE) - tail;
+
+	if (available > count) {
+		available = count;
+	}
+
+	for (unsigned int i = 0; i < available; i++) {
+		samples[i] = ring->Samples[(tail + i) & (ring->Size - 1)];
+	}
+
+	if (available < count) {
+		memset(samples + available, 0, (count - available) * sizeof(short));
+		tone->Underruns += count - available;
+	}
+
+	/*
+	Hand the consumed slots back to the producer.
+	*/
+	__atomic_store_n(&ring->Tail, tail + available, __ATOMIC_RELEASE);
+
+	return available;
+}
+
+unsigned int
+toneAvailable(Tone *tone)
+{
+	return __atomic_load_n(&tone->Ring.Head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tone->Ring.Tail, __ATOMIC_ACQUIRE);
+}
+
+FILE *
+wavOpen(const char *path, unsigned int sampleRate)
+{
+	unsigned char header[44];
+	FILE *wav = fopen(path, "wb");
+
+	if (wav == NULL) {
+		return NULL;
+	}
+
+	/*
+	RIFF and data sizes are patched in by wavClose.
+	*/
+	memcpy(header, "RIFF", 4);
+	writeLe32(header + 4, 36);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	writeLe32(header + 16, 16);
+	writeLe16(header + 20, 1);
+	writeLe16(header + 22, 1);
+	writeLe32(header + 24, sampleRate);
+	writeLe32(header + 28, sampleRate * 2);
+	writeLe16(header + 32, 2);
+	writeLe16(header + 34, 16);
+	memcpy(header + 36, "data", 4);
+	writeLe32(header + 40, 0);
+
+	if (fwrite(header, 1, sizeof(header), wav) != sizeof(header)) {
+		fclose(wav);
+		return NULL;
+	}
+
+	return wav;
+}
+
+int
+wavWrite(FILE *wav, const short *samples, unsigned int count)
+{
+	unsigned char bytes[512];
+
+	while (count > 0) {
+		unsigned int chunk = count < sizeof(bytes) / 2 ? count : sizeof(bytes) / 2;
+
+		for (unsigned int i = 0; i < chunk; i++) {
+			writeLe16(bytes + 2 * i, (unsigned short)samples[i]);
+		}
+
+		if (fwrite(bytes, 2, chunk, wav) != chunk) {
+			return -1;
+		}
+
+		samples += chunk;
+		count -= chunk;
+	}
+
+	return 0;
+}
+
+int
+wavClose(FILE *wav)
+{
+	unsigned char size[4];
+	long length = ftell(wav);
+	int status = 0;
+
+	if (length < 44) {
+		status = -1;
+	} else {
+		writeLe32(size, length - 8);
+		if (fseek(wav, 4, SEEK_SET) != 0 || fwrite(size, 1, 4, wav) != 4) {
+			status = -1;
+		}
+
+		writeLe32(size, length - 44);
+		if (fseek(wav, 40, SEEK_SET) != 0 || fwrite(size, 1, 4, wav) != 4) {
+			status = -1;
+		}
+	}
+
+	if (fclose(wav) != 0) {
+		status = -1;
+	}
+
+	return status;
+}
@@ -0,0 +1,138 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Tone audio.
+The emulation thread synthesizes a square wave for each frame from the on/off edges of the tone register and pushes it into a single producer single consumer ring buffer.
+The ring buffer is drained by an audio device callback or dumped to a WAV file.
+*/
+
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdio.h>
+
+/*
+Maximum number of tone edges recorded in one frame.
+Further edges in the same frame replace the last one.
+*/
+#define TONE_MAX_EDGES 256
+
+/*
+Largest device buffer, in samples, the ring buffer is sized for.
+*/
+#define TONE_MAX_BUFFER_FRAMES 65536
+
+/*
+Type Declarations
+*/
+
+/*
+Lock free single producer single consumer ring buffer of signed 16 bit mono samples.
+Size is a power of two.
+Head is only written by the producer and Tail is only written by the consumer.
+*/
+typedef struct {
+	short *Samples;
+	unsigned int Size;
+	unsigned int Head;
+	unsigned int Tail;
+} ToneRing;
+
+typedef struct {
+	ToneRing Ring;
+	unsigned int SampleRate;
+	unsigned int FramesPerSecond;
+	unsigned int Frequency;
+	short Volume;
+	/*
+	Square wave phase accumulator, counts in units of Frequency up to SampleRate.
+	*/
+	unsigned int Phase;
+	/*
+	Remainder of SampleRate / FramesPerSecond carried between frames.
+	*/
+	unsigned int SampleRemainder;
+	/*
+	Tone state at the start of the current frame.
+	*/
+	int Gate;
+	/*
+	Tone state changes during the current frame, in ticks from the start of the frame.
+	*/
+	unsigned int EdgeCount;
+	unsigned int EdgeTick[TONE_MAX_EDGES];
+	int EdgeGate[TONE_MAX_EDGES];
+	/*
+	Samples dropped because the ring buffer was full and samples of silence inserted because it was empty.
+	*/
+	unsigned long Overruns;
+	unsigned long Underruns;
+} Tone;
+
+/*
+Function Declarations
+*/
+
+/*
+Initialises tone with a ring buffer large enough for bufferFrames samples of device latency plus a frame of emulation.
+Returns 0 on success, -1 if bufferFrames is 0 or more than TONE_MAX_BUFFER_FRAMES, or the ring buffer could not be allocated.
+*/
+int
+toneInit(Tone *tone, unsigned int sampleRate, unsigned int framesPerSecond, unsigned int bufferFrames);
+
+void
+toneFree(Tone *tone);
+
+/*
+Records that the tone turned on or off at tick of the current frame.
+Must only be called from the producer thread.
+*/
+void
+toneEdge(Tone *tone, int on, unsigned int tick);
+
+/*
+Synthesizes the samples for the current frame of ticks ticks and pushes them into the ring buffer.
+Must only be called from the producer thread.
+Returns the number of samples pushed, which is less than were synthesized when the ring buffer overran.
+*/
+unsigned int
+toneEndFrame(Tone *tone, unsigned int ticks);
+
+/*
+Pops count samples from the ring buffer into samples, padding with silence on underrun.
+Must only be called from the consumer thread.
+Returns the number of samples that were available.
+*/
+unsigned int
+toneRead(Tone *tone, short *samples, unsigned int count);
+
+/*
+Number of samples currently in the ring buffer.
+*/
+unsigned int
+toneAvailable(Tone *tone);
+
+/*
+Opens path for writing a mono 16 bit WAV file.
+Returns NULL on failure.
+*/
+FILE *
+wavOpen(const char *path, unsigned int sampleRate);
+
+/*
+Appends count samples to a WAV file opened with wavOpen.
+Returns 0 on success, -1 on failure.
+*/
+int
+wavWrite(FILE *wav, const short *samples, unsigned int count);
+
+/*
+Patches the WAV header sizes and closes the file.
+Returns 0 on success, -1 on failure.
+*/
+int
+wavClose(FILE *wav);
+
+#endif
@@ -0,0 +1,482 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+
+/*
+Runs statement once for every machine in a group, with lane set to the machine.
+A NULL lanes group is the whole batch, which is looped over in order so the compiler can vectorize it.
+*/
+#define EACH_LANE(statement) \
+	do { \
+		if (lanes == NULL) { \
+			for (int lane = 0; lane < batch->Count; lane++) { \
+				statement; \
+			} \
+		} else { \
+			for (int j = 0; j < count; j++) { \
+				int lane = lanes[j]; \
+				statement; \
+			} \
+		} \
+	} while (0)
+
+/*
+Function Declarations
+*/
+
+static void
+unpack(Batch *batch, int lane);
+
+static void
+pack(Batch *batch, int lane);
+
+static void
+markWritten(Batch *batch, unsigned short address, int length);
+
+static int
+isWritten(const Batch *batch, unsigned short address);
+
+static void
+runScalar(Batch *batch, const int *lanes, int count);
+
+static int
+fetch(Batch *batch, int *running);
+
+static void
+takeImage(Batch *batch);
+
+static void
+execute(Batch *batch, unsigned short opcode, const int *lanes, int count);
+
+/*
+Function Definitions
+*/
+
+/*
+Copies the registers of one machine into its State.
+*/
+static void
+unpack(Batch *batch, int lane)
+{
+	State *state = &batch->Machines[lane];
+
+	for (int i = 0; i < 16; i++) {
+		state->V[i] = batch->V[i * batch->Count + lane];
+	}
+	state->I = batch->I[lane];
+	state->ProgramCounter = batch->ProgramCounter[lane];
+	state->Time = batch->Time[lane];
+	state->Tone = batch->Tone[lane];
+}
+
+/*
+Copies the registers of one machine back out of its State.
+*/
+static void
+pack(Batch *batch, int lane)
+{
+	const State *state = &batch->Machines[lane];
+
+	for (int i = 0; i < 16; i++) {
+		batch->V[i * batch->Count + lane] = state->V[i];
+	}
+	batch->I[lane] = state->I;
+	batch->ProgramCounter[lane] = state->ProgramCounter;
+	batch->Time[lane] = state->Time;
+	batch->Tone[lane] = state->Tone;
+}
+
+static void
+markWritten(Batch *batch, unsigned short address, int length)
+{
+	for (int i = 0; i < length; i++) {
+		unsigned short byte = (address + i) & 0xFFF;
+
+		batch->Written[byte >> 3] |= 1 << (byte & 7);
+	}
+}
+
+static int
+isWritten(const Batch *batch, unsigned short address)
+{
+	address &= 0xFFF;
+
+	return batch->Written[address >> 3] & (1 << (address & 7));
+}
+
+/*
+Runs one instruction on each machine of a group through the interpreter.
+*/
+static void
+runScalar(Batch *batch, const int *lanes, int count)
+{
+	EACH_LANE(
+		int executed;
+
+		unpack(batch, lane);
+		if (runUntil(&batch->Machines[lane], 1, 0, &executed) == CHIP8_EXIT) {
+			batch->Status[lane] = batch->Machines[lane].ExitValue;
+		}
+		pack(batch, lane)
+	);
+}
+
+/*
+Runs opcode on a group of machines that are all about to execute it.
+Opcodes that only touch registers are run across the group here, mirroring the opcode functions in chip8.c.
+Everything else goes through runScalar.
+*/
+static void
+execute(Batch *batch, unsigned short opcode, const int *lanes, int count)
+{
+	unsigned char *vX = batch->V + ((opcode & 0xF00) >> 8) * batch->Count;
+	unsigned char *vY = batch->V + ((opcode & 0xF0) >> 4) * batch->Count;
+	unsigned char *v0 = batch->V;
+	unsigned char *vF = batch->V + 15 * batch->Count;
+	unsigned short *pc = batch->ProgramCounter;
+	unsigned char kk = opcode & 0xFF;
+	unsigned short nnn = opcode & 0xFFF;
+	/*
+	Quirks are the same on every machine apart from QUIRK_MEMORY_INCREMENT, which only save and restore use.
+	*/
+	unsigned char *shifted = batch->Quirks & QUIRK_SHIFT_VY ? vY : vX;
+	unsigned char *offset = batch->Quirks & QUIRK_JUMP_VX ? vX : v0;
+	unsigned char keepVF = batch->Quirks & QUIRK_VF_RESET ? 0 : 0xFF;
+
+	switch (opcode & 0xF000) {
+	case 0x0000:
+		if (opcode & 0xF00) {
+			/*
+			0x0NNN
+			*/
+			EACH_LANE(pc[lane] = nnn);
+			return;
+		}
+		break;
+	case 0x3000:
+		if ((opcode & 0xF) == 0) {
+			/*
+			0x3XY0
+			*/
+			EACH_LANE(pc[lane] += vX[lane] == vY[lane] ? 4 : 2);
+		} else {
+			/*
+			0x3XKK
+			*/
+			EACH_LANE(pc[lane] += vX[lane] == kk ? 4 : 2);
+		}
+		return;
+	case 0x4000:
+		EACH_LANE(pc[lane] += vX[lane] != kk ? 4 : 2);
+		return;
+	case 0x6000:
+		EACH_LANE(vX[lane] = kk; pc[lane] += 2);
+		return;
+	case 0x7000:
+		EACH_LANE(vX[lane] += kk; pc[lane] += 2);
+		return;
+	case 0x8000:
+		switch (opcode & 0xF) {
+		case 0x0:
+			EACH_LANE(vX[lane] = vY[lane]; pc[lane] += 2);
+			return;
+		case 0x1:
+			EACH_LANE(vX[lane] |= vY[lane]; vF[lane] &= keepVF; pc[lane] += 2);
+			return;
+		case 0x2:
+			EACH_LANE(vX[lane] &= vY[lane]; vF[lane] &= keepVF; pc[lane] += 2);
+			return;
+		case 0x3:
+			EACH_LANE(vX[lane] ^= vY[lane]; vF[lane] &= keepVF; pc[lane] += 2);
+			return;
+		case 0x4:
+			EACH_LANE(vX[lane] += vY[lane]; pc[lane] += 2);
+			return;
+		case 0x5:
+			EACH_LANE(vF[lane] = vX[lane] < vY[lane]; vX[lane] -= vY[lane]; pc[lane] += 2);
+			return;
+		case 0x6:
+			EACH_LANE(unsigned char value = shifted[lane]; vF[lane] = value & 1; vX[lane] = value >> 1; pc[lane] += 2);
+			return;
+		case 0x7:
+			EACH_LANE(vF[lane] = vX[lane] > vY[lane]; vX[lane] = vY[lane] - vX[lane]; pc[lane] += 2);
+			return;
+		case 0xE:
+			EACH_LANE(unsigned char value = shifted[lane]; vF[lane] = value >> 7; vX[lane] = value << 1; pc[lane] += 2);
+			return;
+		}
+		break;
+	case 0x9000:
+		EACH_LANE(pc[lane] += vX[lane] != vY[lane] ? 4 : 2);
+		return;
+	case 0xA000:
+		EACH_LANE(batch->I[lane] = nnn; pc[lane] += 2);
+		return;
+	case 0xB000:
+		EACH_LANE(pc[lane] = nnn + offset[lane]);
+		return;
+	case 0xF000:
+		switch (kk) {
+		case 0x07:
+			EACH_LANE(vX[lane] = batch->Time[lane]; pc[lane] += 2);
+			return;
+		case 0x15:
+			EACH_LANE(batch->Time[lane] = vX[lane]; pc[lane] += 2);
+			return;
+		case 0x18:
+			EACH_LANE(batch->Tone[lane] = vX[lane]; pc[lane] += 2);
+			return;
+		case 0x1E:
+			EACH_LANE(batch->I[lane] += vX[lane]; pc[lane] += 2);
+			return;
+		case 0x29:
+			EACH_LANE(batch->I[lane] = (vX[lane] & 0xF) << 4; pc[lane] += 2);
+			return;
+		case 0x33:
+			EACH_LANE(markWritten(batch, batch->I[lane], 3));
+			break;
+		case 0x55:
+			EACH_LANE(markWritten(batch, batch->I[lane], ((opcode & 0xF00) >> 8) + 1));
+			break;
+		}
+		break;
+	}
+
+	runScalar(batch, lanes, count);
+}
+
+/*
+Fetches the next opcode of every running machine.
+Returns the opcode if every machine is running and about to execute the same one, else -1 with the running machines in Lanes and their opcodes in Opcodes.
+running is set to the number of machines still running.
+*/
+static int
+fetch(Batch *batch, int *running)
+{
+	unsigned short pc = batch->ProgramCounter[0];
+	int converged = 1;
+
+	/*
+	While every machine is at the same address and none has stored over it the opcode comes from Image without touching the machines.
+	*/
+	for (int lane = 0; lane < batch->Count; lane++) {
+		converged &= (batch->ProgramCounter[lane] == pc) & (batch->Status[lane] == -1);
+	}
+
+	if (converged && !isWritten(batch, pc) && !isWritten(batch, pc + 1)) {
+		*running = batch->Count;
+		return (batch->Image[pc & 0xFFF] << 8) | batch->Image[(pc + 1) & 0xFFF];
+	}
+
+	*running = 0;
+	for (int lane = 0; lane < batch->Count; lane++) {
+		const State *state = &batch->Machines[lane];
+
+		pc = batch->ProgramCounter[lane];
+		if (batch->Status[lane] != -1) {
+			continue;
+		}
+
+		batch->Opcodes[lane] = (readMemory(state, pc) << 8) | readMemory(state, pc + 1);
+		batch->Lanes[(*running)++] = lane;
+	}
+
+	return -1;
+}
+
+/*
+Copies the first machine's memory into Image and forgets every store.
+*/
+static void
+takeImage(Batch *batch)
+{
+	if (batch->Count > 0) {
+		for (int i = 0; i < MEMORY_PAGES; i++) {
+			memcpy(batch->Image + i * MEMORY_PAGE_SIZE, batch->Machines[0].Memory[i]->Bytes, MEMORY_PAGE_SIZE);
+		}
+	}
+
+	memset(batch->Written, 0, sizeof(batch->Written));
+}
+
+int
+batchInit(Batch *batch, int count)
+{
+	batch->Count = count;
+	batch->V = malloc(16 * count * sizeof(*batch->V));
+	batch->I = malloc(count * sizeof(*batch->I));
+	batch->ProgramCounter = malloc(count * sizeof(*batch->ProgramCounter));
+	batch->Time = malloc(count * sizeof(*batch->Time));
+	batch->Tone = malloc(count * sizeof(*batch->Tone));
+	batch->Status = malloc(count * sizeof(*batch->Status));
+	batch->Machines = malloc(count * sizeof(*batch->Machines));
+	batch->Opcodes = malloc(count * sizeof(*batch->Opcodes));
+	batch->Lanes = malloc(count * sizeof(*batch->Lanes));
+
+	if (batch->V == NULL || batch->I == NULL || batch->ProgramCounter == NULL || batch->Time == NULL || batch->Tone == NULL
+		|| batch->Status == NULL || batch->Machines == NULL || batch->Opcodes == NULL || batch->Lanes == NULL) {
+		/*
+		No machine has memory to release yet.
+		*/
+		batch->Count = 0;
+		batchFree(batch);
+		return -1;
+	}
+
+	for (int lane = 0; lane < count; lane++) {
+		initMachineState(&batch->Machines[lane]);
+		pack(batch, lane);
+		batch->Status[lane] = -1;
+	}
+
+	batch->Quirks = QUIRKS_DEFAULT;
+	takeImage(batch);
+
+	return 0;
+}
+
+void
+batchFree(Batch *batch)
+{
+	for (int lane = 0; lane < batch->Count; lane++) {
+		releaseMemory(&batch->Machines[lane]);
+	}
+
+	free(batch->V);
+	free(batch->I);
+	free(batch->ProgramCounter);
+	free(batch->Time);
+	free(batch->Tone);
+	free(batch->Status);
+	free(batch->Machines);
+	free(batch->Opcodes);
+	free(batch->Lanes);
+
+	memset(batch, 0, sizeof(*batch));
+}
+
+int
+batchLoadRom(Batch *batch, const unsigned char *program, size_t size)
+{
+	if (batch->Count == 0) {
+		return 0;
+	}
+
+	if (chip8LoadRom(&batch->Machines[0], program, size) != 0) {
+		return -1;
+	}
+
+	/*
+	Every machine shares the first one's pages until it stores to them.
+	*/
+	for (int lane = 0; lane < batch->Count; lane++) {
+		State *state = &batch->Machines[lane];
+
+		if (lane > 0) {
+			releaseMemory(state);
+			initMachineState(state);
+			shareMemory(state, &batch->Machines[0]);
+		}
+
+		pack(batch, lane);
+		batch->Status[lane] = -1;
+	}
+
+	batch->Quirks = QUIRKS_DEFAULT;
+	takeImage(batch);
+
+	return 0;
+}
+
+void
+batchSetQuirks(Batch *batch, int quirks)
+{
+	batch->Quirks = quirks;
+
+	for (int lane = 0; lane < batch->Count; lane++) {
+		chip8SetQuirks(&batch->Machines[lane], quirks);
+	}
+}
+
+void
+batchSetKeys(Batch *batch, int machine, unsigned short keys)
+{
+	chip8SetKeys(&batch->Machines[machine], keys);
+}
+
+int
+batchRunCycles(Batch *batch, int cycles)
+{
+	int running = 0;
+
+	for (int cycle = 0; cycle < cycles; cycle++) {
+		int opcode = fetch(batch, &running);
+
+		if (running == 0) {
+			break;
+		}
+
+		if (opcode != -1) {
+			execute(batch, opcode, NULL, batch->Count);
+			continue;
+		}
+
+		/*
+		The machines have diverged, run each group that shares an opcode together.
+		*/
+		for (int start = 0; start < running;) {
+			int end = start;
+
+			opcode = batch->Opcodes[batch->Lanes[start]];
+			for (int j = start; j < running; j++) {
+				int lane = batch->Lanes[j];
+
+				if (batch->Opcodes[lane] == opcode) {
+					batch->Lanes[j] = batch->Lanes[end];
+					batch->Lanes[end++] = lane;
+				}
+			}
+
+			execute(batch, opcode, batch->Lanes + start, end - start);
+			start = end;
+		}
+	}
+
+	running = 0;
+	for (int lane = 0; lane < batch->Count; lane++) {
+		running += batch->Status[lane] == -1;
+	}
+
+	return running;
+}
+
+void
+batchTickTimers(Batch *batch)
+{
+	for (int lane = 0; lane < batch->Count; lane++) {
+		if (batch->Machines[lane].WaitingForKeyPress) {
+			continue;
+		}
+
+		if (batch->Time[lane] > 0) {
+			batch->Time[lane] -= 1;
+		}
+
+		if (batch->Tone[lane] > 0) {
+			batch->Tone[lane] -= 1;
+		}
+	}
+}
+
+const State *
+batchMachine(Batch *batch, int machine)
+{
+	unpack(batch, machine);
+
+	return &batch->Machines[machine];
+}
@@ -0,0 +1,108 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Lockstep batch of machines running the same program.
+The registers of every machine are stored structure of arrays so that machines executing the same opcode are stepped together in one loop over the batch.
+Memory, the stack and the display buffer stay with each machine's State, opcodes that touch them are run one machine at a time through runUntil.
+Every machine shares the memory pages of the loaded program until it stores to them.
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+
+#include "chip8.h"
+
+/*
+Type Declarations
+*/
+
+typedef struct {
+	int Count;
+	/*
+	Indexed [register * Count + machine].
+	*/
+	unsigned char *V;
+	unsigned short *I;
+	unsigned short *ProgramCounter;
+	unsigned char *Time;
+	unsigned char *Tone;
+	/*
+	-1 while the machine is running, else its exit value.
+	*/
+	int *Status;
+	/*
+	Everything else about each machine.
+	Its registers are only up to date while an opcode is being run through it, use batchMachine to read them.
+	*/
+	State *Machines;
+	/*
+	Quirks of every machine.
+	*/
+	int Quirks;
+	/*
+	Memory as loaded, and one bit per byte any machine has since stored to.
+	Opcodes are fetched from Image while the machines agree on the program counter and nothing has been stored there.
+	*/
+	unsigned char Image[0x1000];
+	unsigned char Written[0x1000 / 8];
+	/*
+	Scratch space for grouping machines by opcode.
+	*/
+	unsigned short *Opcodes;
+	int *Lanes;
+} Batch;
+
+/*
+Function Declarations
+*/
+
+/*
+Returns 0 on success, -1 if memory ran out.
+*/
+int
+batchInit(Batch *batch, int count);
+
+void
+batchFree(Batch *batch);
+
+/*
+Resets every machine and loads program into each of them.
+Returns 0 on success, -1 if the program does not fit in memory.
+*/
+int
+batchLoadRom(Batch *batch, const unsigned char *program, size_t size);
+
+/*
+Selects the quirks of every machine like chip8SetQuirks.
+*/
+void
+batchSetQuirks(Batch *batch, int quirks);
+
+void
+batchSetKeys(Batch *batch, int machine, unsigned short keys);
+
+/*
+Runs cycles instructions on every machine that has not exited.
+Returns the number of machines still running.
+*/
+int
+batchRunCycles(Batch *batch, int cycles);
+
+/*
+Counts the time and tone registers of every machine down by one.
+Call at 60 Hz.
+*/
+void
+batchTickTimers(Batch *batch);
+
+/*
+Copies the registers of a machine into its State and returns it.
+*/
+const State *
+batchMachine(Batch *batch, int machine);
+
+#endif
@@ -0,0 +1,622 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "chip8.h"
+#include "rom.h"
+
+/*
+Type Declarations
+*/
+
+/*
+Abstract value of a register during the walk.
+*/
+enum {
+	ABSENT,
+	KNOWN,
+	UNKNOWN
+};
+
+typedef struct {
+	unsigned char Kind;
+	unsigned short Value;
+} Abstract;
+
+typedef struct {
+	Abstract I;
+	Abstract V0;
+	Abstract Compatibility;
+} WalkState;
+
+/*
+Scratch space for one cfgBuild.
+Per address arrays are filled in for the instruction starting at that address.
+*/
+typedef struct {
+	const unsigned char *Memory;
+	Cfg *Cfg;
+	int Quirks;
+	/*
+	Set if the program contains a compatability opcode anywhere, in which case a subroutine may have turned it on.
+	*/
+	int MaySetCompatibility;
+	WalkState Entry[CFG_MEMORY_SIZE];
+	/*
+	Merge of every state an instruction was walked with, for when a later jump splits its block.
+	*/
+	WalkState Seen[CFG_MEMORY_SIZE];
+	/*
+	Exit kind + 1 for instructions that end a block, else 0.
+	*/
+	unsigned char Terminator[CFG_MEMORY_SIZE];
+	unsigned char SuccessorCount[CFG_MEMORY_SIZE];
+	unsigned short Successors[CFG_MEMORY_SIZE][2];
+	unsigned char HasStore[CFG_MEMORY_SIZE];
+	CfgStore Store[CFG_MEMORY_SIZE];
+	unsigned char Indirect[CFG_MEMORY_SIZE];
+	unsigned char Queued[CFG_MEMORY_SIZE];
+	int WorklistCount;
+	unsigned short Worklist[CFG_MEMORY_SIZE];
+} Walk;
+
+/*
+Function Declarations
+*/
+
+static Abstract
+known(unsigned short value);
+
+static Abstract
+unknown(void);
+
+static int
+merge(Abstract *into, Abstract value);
+
+static int
+mergeState(WalkState *into, const WalkState *state);
+
+static void
+propagate(Walk *walk, unsigned short address, const WalkState *state);
+
+static void
+markRange(Cfg *cfg, unsigned short start, unsigned short length, unsigned char flag);
+
+static void
+advanceI(WalkState *state, unsigned char registerX);
+
+static void
+walkBlock(Walk *walk, unsigned short address);
+
+static int
+buildBlocks(Walk *walk);
+
+static int
+collect(Walk *walk);
+
+/*
+Function Definitions
+*/
+
+static Abstract
+known(unsigned short value)
+{
+	Abstract abstract = { KNOWN, value };
+
+	return abstract;
+}
+
+static Abstract
+unknown(void)
+{
+	Abstract abstract = { UNKNOWN, 0 };
+
+	return abstract;
+}
+
+/*
+Merges value into into.
+Returns non zero if into changed.
+*/
+static int
+merge(Abstract *into, Abstract value)
+{
+	if (value.Kind == ABSENT || into->Kind == UNKNOWN) {
+		return 0;
+	}
+
+	if (into->Kind == ABSENT) {
+		*into = value;
+		return 1;
+	}
+
+	if (value.Kind == KNOWN && value.Value == into->Value) {
+		return 0;
+	}
+
+	*into = unknown();
+
+	return 1;
+}
+
+/*
+Merges state into into.
+Returns non zero if into changed.
+*/
+static int
+mergeState(WalkState *into, const WalkState *state)
+{
+	int changed = 0;
+
+	changed |= merge(&into->I, state->I);
+	changed |= merge(&into->V0, state->V0);
+	changed |= merge(&into->Compatibility, state->Compatibility);
+
+	return changed;
+}
+
+/*
+Merges state into the entry state of the block at address, queueing it if it changed.
+*/
+static void
+propagate(Walk *walk, unsigned short address, const WalkState *state)
+{
+	Cfg *cfg = walk->Cfg;
+	WalkState *entry;
+	int changed = 0;
+
+	if (address > CFG_MEMORY_SIZE - 2) {
+		return;
+	}
+
+	entry = &walk->Entry[address];
+
+	/*
+	A new leader in the middle of walked code is also reached by falling through from the code before it.
+	*/
+	if (!(cfg->Flags[address] & CFG_LEADER) && (cfg->Flags[address] & CFG_CODE)) {
+		mergeState(entry, &walk->Seen[address]);
+	}
+
+	cfg->Flags[address] |= CFG_LEADER;
+
+	/*
+	Every visited entry has a known or unknown Compatibility, so ABSENT marks a new block.
+	*/
+	if (entry->Compatibility.Kind == ABSENT) {
+		changed = 1;
+	}
+
+	changed |= mergeState(entry, state);
+
+	if (changed && !walk->Queued[address]) {
+		walk->Queued[address] = 1;
+		walk->Worklist[walk->WorklistCount++] = address;
+	}
+}
+
+static void
+markRange(Cfg *cfg, unsigned short start, unsigned short length, unsigned char flag)
+{
+	for (unsigned int i = start; i < (unsigned int)start + length && i < CFG_MEMORY_SIZE; i++) {
+		cfg->Flags[i] |= flag;
+	}
+}
+
+/*
+save and restore leave I past the last register unless compatability is on.
+Compatibility stands for QUIRK_MEMORY_INCREMENT being off, so it starts on for profiles without it.
+*/
+static void
+advanceI(WalkState *state, unsigned char registerX)
+{
+	if (state->Compatibility.Kind != KNOWN) {
+		state->I = unknown();
+	} else if (!state->Compatibility.Value && state->I.Kind == KNOWN) {
+		state->I.Value += registerX + 1;
+	}
+}
+
+/*
+Walks the instructions of one block from address, recording stores and successors.
+*/
+static void
+walkBlock(Walk *walk, unsigned short address)
+{
+	Cfg *cfg = walk->Cfg;
+	WalkState state = walk->Entry[address];
+	unsigned short pc = address;
+
+	for (;;) {
+		unsigned short opcode;
+		unsigned char registerX;
+		int exit = -1;
+		int count = 0;
+		unsigned short successors[2];
+		WalkState returnState;
+
+		if (pc > CFG_MEMORY_SIZE - 2) {
+			/*
+			Can only happen by falling off the end of memory.
+			*/
+			walk->Terminator[pc - 2] = CFG_OFF_END + 1;
+			walk->SuccessorCount[pc - 2] = 0;
+			return;
+		}
+
+		if (pc != address && (cfg->Flags[pc] & CFG_LEADER)) {
+			propagate(walk, pc, &state);
+			return;
+		}
+
+		cfg->Flags[pc] |= CFG_CODE;
+		cfg->Flags[pc + 1] |= CFG_CODE;
+		mergeState(&walk->Seen[pc], &state);
+
+		opcode = (walk->Memory[pc] << 8) | walk->Memory[pc + 1];
+		registerX = (opcode & 0xF00) >> 8;
+
+		switch (opcode & 0xF000) {
+		case 0x0000:
+			if (opcode & 0xF00) {
+				exit = CFG_JUMP;
+				successors[count++] = opcode & 0xFFF;
+			} else if ((opcode & 0xF0) == 0x10 || opcode == 0x00FD) {
+				exit = CFG_EXIT;
+			} else if (opcode == 0x00EE) {
+				exit = CFG_RETURN;
+			} else if (opcode == 0x00FA) {
+				state.Compatibility = known(1);
+			}
+			break;
+		case 0x1000:
+			exit = CFG_CALL;
+			successors[count++] = pc + 2;
+			successors[count++] = opcode & 0xFFF;
+			cfg->Flags[opcode & 0xFFF] |= CFG_CALL_TARGET;
+			break;
+		case 0x3000:
+		case 0x4000:
+		case 0x9000:
+			exit = CFG_SKIP;
+			break;
+		case 0x6000:
+			if (registerX == 0) {
+				state.V0 = known(opcode & 0xFF);
+			}
+			break;
+		case 0x7000:
+			if (registerX == 0 && state.V0.Kind == KNOWN) {
+				state.V0.Value = (state.V0.Value + (opcode & 0xFF)) & 0xFF;
+			}
+			break;
+		case 0x8000:
+		case 0xC000:
+			if (registerX == 0) {
+				state.V0 = unknown();
+			}
+			break;
+		case 0xA000:
+			state.I = known(opcode & 0xFFF);
+			break;
+		case 0xB000:
+			/*
+			With QUIRK_JUMP_VX the offset comes from a register the walk does not track, unless it is v0.
+			*/
+			if (state.V0.Kind == KNOWN && (!(walk->Quirks & QUIRK_JUMP_VX) || registerX == 0)) {
+				exit = CFG_JUMP;
+				successors[count++] = (opcode & 0xFFF) + state.V0.Value;
+				walk->Indirect[pc] = 0;
+			} else {
+				exit = CFG_INDIRECT;
+				walk->Indirect[pc] = 1;
+			}
+			break;
+		case 0xD000:
+			if (state.I.Kind == KNOWN) {
+				markRange(cfg, state.I.Value, (opcode & 0xF) ? opcode & 0xF : 32, CFG_READ);
+			}
+			/*
+			The interpreter falls through from draw into the key skips, so a draw with a low byte of 0x9E or 0xA1 also skips.
+			*/
+			if ((opcode & 0xFF) == 0x9E || (opcode & 0xFF) == 0xA1) {
+				exit = CFG_SKIP;
+			}
+			break;
+		case 0xE000:
+			if ((opcode & 0xFF) == 0x9E || (opcode & 0xFF) == 0xA1) {
+				exit = CFG_SKIP;
+			}
+			break;
+		case 0xF000:
+			switch (opcode & 0xFF) {
+			case 0x07:
+			case 0x0A:
+				if (registerX == 0) {
+					state.V0 = unknown();
+				}
+				break;
+			case 0x1E:
+				if (registerX == 0 && state.V0.Kind == KNOWN && state.I.Kind == KNOWN) {
+					state.I.Value += state.V0.Value;
+				} else {
+					state.I = unknown();
+				}
+				break;
+			case 0x29:
+				if (registerX == 0 && state.V0.Kind == KNOWN) {
+					state.I = known((state.V0.Value & 0xF) << 4);
+				} else {
+					state.I = unknown();
+				}
+				break;
+			case 0x33:
+			case 0x55:
+				/*
+				A store walked again with a different I is unresolved.
+				*/
+				if (state.I.Kind != KNOWN || (walk->HasStore[pc] && walk->Store[pc].Start != state.I.Value)) {
+					walk->Store[pc].Length = 0;
+				} else if (!walk->HasStore[pc]) {
+					walk->Store[pc].Start = state.I.Value;
+					walk->Store[pc].Length = (opcode & 0xFF) == 0x33 ? 3 : registerX + 1;
+					markRange(cfg, state.I.Value, walk->Store[pc].Length, CFG_WRITTEN);
+				}
+				walk->HasStore[pc] = 1;
+				walk->Store[pc].Address = pc;
+				walk->Store[pc].Opcode = opcode;
+				if ((opcode & 0xFF) == 0x55) {
+					advanceI(&state, registerX);
+				}
+				break;
+			case 0x65:
+				if (state.I.Kind == KNOWN) {
+					markRange(cfg, state.I.Value, registerX + 1, CFG_READ);
+				}
+				state.V0 = unknown();
+				advanceI(&state, registerX);
+				break;
+			}
+			break;
+		}
+
+		if (exit == CFG_SKIP) {
+			successors[count++] = pc + 2;
+			successors[count++] = pc + 4;
+		}
+
+		if (exit == -1) {
+			pc += 2;
+			continue;
+		}
+
+		walk->Terminator[pc] = exit + 1;
+		walk->SuccessorCount[pc] = count;
+		memcpy(walk->Successors[pc], successors, count * sizeof(successors[0]));
+
+		/*
+		A subroutine may change anything we track, so its return site starts from scratch.
+		*/
+		returnState = state;
+		returnState.I = unknown();
+		returnState.V0 = unknown();
+		if (walk->MaySetCompatibility) {
+			returnState.Compatibility = unknown();
+		}
+
+		for (int i = 0; i < count; i++) {
+			propagate(walk, successors[i], exit == CFG_CALL && i == 0 ? &returnState : &state);
+		}
+
+		return;
+	}
+}
+
+/*
+Splits the walked code into blocks at every leader.
+*/
+static int
+buildBlocks(Walk *walk)
+{
+	Cfg *cfg = walk->Cfg;
+	int capacity = 0;
+
+	for (unsigned int address = 0; address < CFG_MEMORY_SIZE; address++) {
+		if ((cfg->Flags[address] & CFG_LEADER) && (cfg->Flags[address] & CFG_CODE)) {
+			++capacity;
+		}
+	}
+
+	cfg->Blocks = calloc(capacity ? capacity : 1, sizeof(CfgBlock));
+	if (cfg->Blocks == NULL) {
+		return -1;
+	}
+
+	for (unsigned int address = 0; address < CFG_MEMORY_SIZE; address++) {
+		CfgBlock *block;
+		unsigned int pc = address;
+
+		if (!(cfg->Flags[address] & CFG_LEADER) || !(cfg->Flags[address] & CFG_CODE)) {
+			continue;
+		}
+
+		block = &cfg->Blocks[cfg->BlockCount++];
+		block->Start = address;
+
+		for (;;) {
+			if (walk->Terminator[pc]) {
+				block->End = pc + 2;
+				block->Exit = walk->Terminator[pc] - 1;
+				block->SuccessorCount = walk->SuccessorCount[pc];
+				memcpy(block->Successors, walk->Successors[pc], sizeof(block->Successors));
+				break;
+			}
+
+			pc += 2;
+
+			if (pc > CFG_MEMORY_SIZE - 2 || !(cfg->Flags[pc] & CFG_CODE) || (cfg->Flags[pc] & CFG_LEADER)) {
+				block->End = pc;
+				block->Exit = CFG_FALLTHROUGH;
+				block->SuccessorCount = 1;
+				block->Successors[0] = pc;
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+Gathers the per address stores and indirect jumps into cfg.
+*/
+static int
+collect(Walk *walk)
+{
+	Cfg *cfg = walk->Cfg;
+	int stores = 0;
+	int indirects = 0;
+
+	for (unsigned int address = 0; address < CFG_MEMORY_SIZE; address++) {
+		stores += walk->HasStore[address];
+		indirects += walk->Indirect[address];
+	}
+
+	cfg->Stores = calloc(stores ? stores : 1, sizeof(CfgStore));
+	cfg->Indirects = calloc(indirects ? indirects : 1, sizeof(CfgIndirect));
+	if (cfg->Stores == NULL || cfg->Indirects == NULL) {
+		return -1;
+	}
+
+	for (unsigned int address = 0; address < CFG_MEMORY_SIZE; address++) {
+		if (walk->HasStore[address]) {
+			CfgStore *store = &cfg->Stores[cfg->StoreCount++];
+
+			*store = walk->Store[address];
+
+			for (unsigned int i = store->Start; i < (unsigned int)store->Start + store->Length && i < CFG_MEMORY_SIZE; i++) {
+				if (cfg->Flags[i] & CFG_CODE) {
+					store->IntoCode = 1;
+				}
+			}
+
+			cfg->SelfModifying += store->IntoCode;
+		}
+
+		if (walk->Indirect[address]) {
+			CfgIndirect *indirect = &cfg->Indirects[cfg->IndirectCount++];
+
+			indirect->Address = address;
+			indirect->Opcode = (walk->Memory[address] << 8) | walk->Memory[address + 1];
+		}
+	}
+
+	return 0;
+}
+
+int
+cfgBuild(Cfg *cfg, const unsigned char *memory, int quirks)
+{
+	Walk *walk = calloc(1, sizeof(Walk));
+	WalkState start;
+	int status = 0;
+
+	memset(cfg, 0, sizeof(*cfg));
+
+	if (walk == NULL) {
+		return -1;
+	}
+
+	walk->Memory = memory;
+	walk->Cfg = cfg;
+	walk->Quirks = quirks;
+
+	for (unsigned int address = ROM_START; address < CFG_MEMORY_SIZE - 1; address++) {
+		if (memory[address] == 0x00 && memory[address + 1] == 0xFA) {
+			walk->MaySetCompatibility = 1;
+		}
+	}
+
+	/*
+	The machine starts with I = 0, v0 = 0 and compatability off unless the quirks already leave I alone.
+	*/
+	start.I = known(0);
+	start.V0 = known(0);
+	start.Compatibility = known(!(quirks & QUIRK_MEMORY_INCREMENT));
+	propagate(walk, ROM_START, &start);
+
+	while (walk->WorklistCount > 0) {
+		unsigned short address = walk->Worklist[--walk->WorklistCount];
+
+		walk->Queued[address] = 0;
+		walkBlock(walk, address);
+	}
+
+	if (buildBlocks(walk) != 0 || collect(walk) != 0) {
+		cfgFree(cfg);
+		status = -1;
+	}
+
+	free(walk);
+
+	return status;
+}
+
+void
+cfgFree(Cfg *cfg)
+{
+	free(cfg->Blocks);
+	free(cfg->Stores);
+	free(cfg->Indirects);
+	cfg->Blocks = NULL;
+	cfg->Stores = NULL;
+	cfg->Indirects = NULL;
+	cfg->BlockCount = 0;
+	cfg->StoreCount = 0;
+	cfg->IndirectCount = 0;
+}
+
+const CfgBlock *
+cfgBlockAt(const Cfg *cfg, unsigned short address)
+{
+	int low = 0;
+	int high = cfg->BlockCount - 1;
+
+	while (low <= high) {
+		int middle = (low + high) / 2;
+
+		if (cfg->Blocks[middle].Start == address) {
+			return &cfg->Blocks[middle];
+		} else if (cfg->Blocks[middle].Start < address) {
+			low = middle + 1;
+		} else {
+			high = middle - 1;
+		}
+	}
+
+	return NULL;
+}
+
+int
+cfgVerdict(const Cfg *cfg)
+{
+	if (cfg->SelfModifying) {
+		return CFG_SELF_MODIFYING;
+	}
+
+	for (int i = 0; i < cfg->StoreCount; i++) {
+		if (cfg->Stores[i].Length == 0) {
+			return CFG_UNRESOLVED;
+		}
+	}
+
+	if (cfg->IndirectCount) {
+		return CFG_UNRESOLVED;
+	}
+
+	return CFG_SAFE;
+}
@@ -0,0 +1,129 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Static control flow recovery.
+Walks a program from ROM_START following jump, call, jump v0 and skip semantics, splits it into basic blocks, and records which bytes are code, which are read as data and which are written by save and bcd.
+The I register, v0 and the compatability flag are tracked through the walk so that stores and jump v0 targets can be resolved where they are constant.
+The walk follows the quirks the program is run with, which change where jump v0 goes and whether save and restore move I.
+*/
+
+#ifndef CFG_H
+#define CFG_H
+
+#define CFG_MEMORY_SIZE 0x1000
+
+/*
+Per byte flags.
+*/
+enum {
+	CFG_CODE = 1 << 0,
+	CFG_LEADER = 1 << 1,
+	CFG_READ = 1 << 2,
+	CFG_WRITTEN = 1 << 3,
+	CFG_CALL_TARGET = 1 << 4
+};
+
+/*
+How a block ends.
+*/
+enum {
+	CFG_FALLTHROUGH,
+	CFG_JUMP,
+	CFG_SKIP,
+	CFG_CALL,
+	CFG_RETURN,
+	CFG_INDIRECT,
+	CFG_EXIT,
+	CFG_OFF_END
+};
+
+/*
+Program verdicts, from safest to least safe.
+*/
+enum {
+	CFG_SAFE,
+	CFG_UNRESOLVED,
+	CFG_SELF_MODIFYING
+};
+
+/*
+Type Declarations
+*/
+
+typedef struct {
+	unsigned short Start;
+	/*
+	Address after the last instruction.
+	*/
+	unsigned short End;
+	int Exit;
+	/*
+	Successor blocks, the fall through or return site first.
+	*/
+	int SuccessorCount;
+	unsigned short Successors[2];
+} CfgBlock;
+
+/*
+A save or bcd.
+Length is 0 when the I register could not be resolved.
+*/
+typedef struct {
+	unsigned short Address;
+	unsigned short Opcode;
+	unsigned short Start;
+	unsigned short Length;
+	int IntoCode;
+} CfgStore;
+
+/*
+A jump v0 whose target could not be resolved.
+*/
+typedef struct {
+	unsigned short Address;
+	unsigned short Opcode;
+} CfgIndirect;
+
+typedef struct {
+	unsigned char Flags[CFG_MEMORY_SIZE];
+	int BlockCount;
+	CfgBlock *Blocks;
+	int StoreCount;
+	CfgStore *Stores;
+	int IndirectCount;
+	CfgIndirect *Indirects;
+	/*
+	Number of stores that write to code.
+	*/
+	int SelfModifying;
+} Cfg;
+
+/*
+Function Declarations
+*/
+
+/*
+Builds the control flow graph of the program in memory, which must be CFG_MEMORY_SIZE bytes with the program at ROM_START, run with quirks.
+Returns 0 on success, -1 if memory ran out.
+*/
+int
+cfgBuild(Cfg *cfg, const unsigned char *memory, int quirks);
+
+void
+cfgFree(Cfg *cfg);
+
+/*
+Returns the block starting at address, or NULL if there is none.
+*/
+const CfgBlock *
+cfgBlockAt(const Cfg *cfg, unsigned short address);
+
+/*
+Returns CFG_SAFE, CFG_UNRESOLVED or CFG_SELF_MODIFYING.
+*/
+int
+cfgVerdict(const Cfg *cfg);
+
+#endif
@@ -0,0 +1,2082 @@
+/*
+A Chip8 interpreter written in c99 suckless.
+
+zlib License
+
+(C) 2020 Chester J.F. Gould 
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "chip8.h"
+#include "opcodes.h"
+#include "rom.h"
+
+/*
+Type Declarations
+*/
+
+/*
+What the debugging loop saw of the watched registers before an instruction, and where the instruction stores.
+*/
+typedef struct {
+	unsigned char V[16];
+	unsigned short I;
+	unsigned short StoreAddress;
+	int StoreLength;
+} Watch;
+
+/*
+Runs one opcode for the table dispatched interpreter.
+Returns the event it causes, or 0.
+*/
+typedef int (*Handler)(State *state, unsigned short opcode);
+
+/*
+Global Variables
+*/
+
+/*
+The hex character images at 0xN0.
+Static pages hold a reference of their own so they are never freed.
+*/
+static Page FontPage = {
+	1,
+	{
+		/*
+		####
+		#  #
+		#  #
+		####
+		*/
+		[0x00] = 0xf0, 0x90, 0x90, 0x90, 0xf0,
+		/*
+		  #
+		 ##
+		  #
+		 ###	
+		*/
+		[0x10] = 0x20, 0x60, 0x20, 0x20, 0x70,
+		/*
+		####
+		   #
+		####
+		#
+		####
+		*/
+		[0x20] = 0xf0, 0x10, 0xf0, 0x80, 0xf0,
+		/*
+		####
+		   #
+		####
+		   #
+		####	
+		*/
+		[0x30] = 0xf0, 0x10, 0xf0, 0x10, 0xf0,
+		/*
+		#  #
+		#  #
+		####
+		   #
+		   #
+		*/
+		[0x40] = 0x90, 0x90, 0xf0, 0x10, 0x10,
+		/*
+		####
+		#
+		####
+		   #
+		####
+		*/
+		[0x50] = 0xf0, 0x80, 0xf0, 0x10, 0xf0,
+		/*
+		####
+		#
+		####
+		#  #
+		####	
+		*/
+		[0x60] = 0xf0, 0x80, 0xf0, 0x90, 0xf0,
+		/*
+		####
+		   #
+		  #
+		 #
+		 #
+		*/
+		[0x70] = 0xf0, 0x10, 0x20, 0x40, 0x40,
+		/*
+		####
+		#  #
+		####
+		#  #
+		####
+		*/
+		[0x80] = 0xf0, 0x90, 0xf0, 0x90, 0xf0,
+		/*
+		####
+		#  #
+		####
+		   #
+		####
+		*/
+		[0x90] = 0xf0, 0x90, 0xf0, 0x10, 0xf0,
+		/*
+		####
+		#  #
+		####
+		#  #
+		#  #
+		*/
+		[0xa0] = 0xf0, 0x90, 0xa0, 0x90, 0x90,
+		/*
+		###
+		#  #
+		###
+		#  #
+		###
+		*/
+		[0xb0] = 0xe0, 0x90, 0xe0, 0x90, 0xe0,
+		/*
+		####
+		#
+		#
+		#
+		####
+		*/
+		[0xc0] = 0xf0, 0x80, 0x80, 0x80, 0xf0,
+		/*
+		###
+		#  #
+		#  #
+		#  #
+		###
+		*/
+		[0xd0] = 0xe0, 0x90, 0x90, 0x90, 0xe0,
+		/*
+		####
+		#
+		####
+		#
+		####
+		*/
+		[0xe0] = 0xf0, 0x80, 0xf0, 0x80, 0xf0,
+		/*
+		####
+		#
+		####
+		#
+		#
+		*/
+		[0xf0] = 0xf0, 0x80, 0xf0, 0x80, 0x80,
+	}
+};
+
+static Page ZeroPage = {
+	1,
+	{ 0 }
+};
+
+static const struct {
+	const char *Name;
+	int Quirks;
+} Profiles[] = {
+	{ "default", QUIRKS_DEFAULT },
+	{ "chip8", QUIRKS_CHIP8 },
+	{ "schip", QUIRKS_SCHIP },
+	{ "xochip", QUIRKS_XOCHIP }
+};
+
+static const struct {
+	const char *Name;
+	int Timing;
+} Timings[] = {
+	{ "fast", CHIP8_TIMING_FAST },
+	{ "cosmac", CHIP8_TIMING_COSMAC }
+};
+
+/*
+Approximate COSMAC VIP machine cycles of the opcodes, by their top nibble, on top of the cycles every instruction takes to be fetched and decoded.
+opcodeCycles adds the rows of draws and the registers of save and restore.
+*/
+#define FETCH_CYCLES 40
+#define ROW_CYCLES 18
+#define REGISTER_CYCLES 14
+
+static const unsigned char GroupCycles[16] = {
+	[0x0] = 24,
+	[0x1] = 26,
+	[0x3] = 10,
+	[0x4] = 10,
+	[0x6] = 6,
+	[0x7] = 10,
+	[0x8] = 44,
+	[0x9] = 14,
+	[0xA] = 12,
+	[0xB] = 22,
+	[0xC] = 36,
+	[0xD] = 26,
+	[0xE] = 14,
+	[0xF] = 16
+};
+
+static const struct {
+	const char *Name;
+	int Engine;
+} Engines[] = {
+	{ "switch", CHIP8_ENGINE_SWITCH },
+	{ "table", CHIP8_ENGINE_TABLE }
+};
+
+/*
+Handlers of the table dispatched interpreter, one for every description in opcodes.h.
+Entry 0 is for opcodes no description matches.
+*/
+#define OPCODE_DECLARATION(mask, match, handler, mnemonic, first, second, third) static int handler(State *state, unsigned short opcode);
+#define OPCODE_HANDLER(mask, match, handler, mnemonic, first, second, third) { mask, match, handler },
+
+OPCODES(OPCODE_DECLARATION)
+
+static const struct {
+	unsigned short Mask;
+	unsigned short Match;
+	Handler Run;
+} Handlers[] = {
+	{ 0x0000, 0x0000, opNone },
+	OPCODES(OPCODE_HANDLER)
+};
+
+/*
+Index into Handlers of every opcode, filled in by buildDecode the first time the table engine is selected.
+*/
+static unsigned char Decode[0x10000];
+static int DecodeReady;
+
+/*
+Returned by the interpreter loops when the compatability opcode has changed the quirks.
+*/
+#define CORE_QUIRKS_CHANGED (1 << 15)
+
+/*
+Function Declarations
+*/
+
+/*
+Opcodes that depend on quirks.
+The opcode functions pass the quirks of the machine, the interpreter loops pass their own so that the checks fold away.
+*/
+
+static inline void
+jumpv0Quirks(State *state, unsigned short address, int quirks);
+
+static inline void
+orvXvYQuirks(State *state, unsigned char registerX, unsigned char registerY, int quirks);
+
+static inline void
+andvXvYQuirks(State *state, unsigned char registerX, unsigned char registerY, int quirks);
+
+static inline void
+xorvXvYQuirks(State *state, unsigned char registerX, unsigned char registerY, int quirks);
+
+static inline void
+shrvXQuirks(State *state, unsigned char registerX, unsigned char registerY, int quirks);
+
+static inline void
+shlvXQuirks(State *state, unsigned char registerX, unsigned char registerY, int quirks);
+
+static inline void
+savevXQuirks(State *state, unsigned char registerX, int quirks);
+
+static inline void
+restorevXQuirks(State *state, unsigned char registerX, int quirks);
+
+static inline void
+drawSprite(State *state, unsigned char registerX, unsigned char registerY, int rows, int wide, int quirks);
+
+static inline int
+opcodeCycles(unsigned short opcode, int frameTick, int ticksPerFrame);
+
+static void
+watchBefore(const State *state, unsigned short opcode, Watch *watch);
+
+static int
+watchAfter(State *state, const Watch *watch);
+
+static void
+buildDecode(void);
+
+static int
+runTable(State *state, int frameTick, int ticks, int events, int *executed);
+
+/*
+Function Definitions
+*/
+
+/*
+Chip8 Definitions
+*/
+
+/*
+0x00E0
+clear
+Clears the screen.
+*/
+void
+clearScreen(State *state)
+{
+	memset(state->DisplayBuffer.High, 0, sizeof(state->DisplayBuffer.High));
+	state->DirtyRows = ~0ULL;
+}
+
+/*
+0x00EE
+ret
+Returns from subroutine.
+The stack is a ring of 32 return addresses, returning with nothing on it takes the oldest.
+*/
+void
+subroutineReturn(State *state)
+{
+	state->ProgramCounter = state->Stack[state->StackCounter & 31];
+	state->StackCounter = (state->StackCounter & 31) - 1;
+}
+
+/*
+DEPRECATED
+0x00FA
+compatability
+Only for backwards compatability.
+Causes "save" and "restore" opcodes to leave I register unchanged by clearing QUIRK_MEMORY_INCREMENT.
+*/
+void
+compatability(State *state)
+{
+	state->Quirks &= ~QUIRK_MEMORY_INCREMENT;
+}
+
+/*
+0x0NNN
+jump addr
+Jumps to address NNN
+NNN must be even.
+NNN must be in range 0x200 to 0xFFE.
+*/
+void
+jump(State *state, unsigned short address)
+{
+	state->ProgramCounter = address - 2;
+}
+
+/*
+0xBNNN
+jump addr, v0
+Jumps to address NNN + v0
+NNN must be even.
+v0 must be even.
+NNN + v0 must be even.
+NNN + v0 must be in range 0x200 to 0xFFE.
+*/
+void
+jumpv0(State *state, unsigned short address)
+{
+	jumpv0Quirks(state, address, state->Quirks);
+}
+
+static inline void
+jumpv0Quirks(State *state, unsigned short address, int quirks)
+{
+	unsigned char offset = quirks & QUIRK_JUMP_VX ? state->V[(address >> 8) & 0xF] : state->V[0];
+
+	state->ProgramCounter = address + offset - 2;
+}
+
+/*
+0x1NNN
+call addr
+Calls subroutine at address NNN.
+NNN must be even.
+NNN must be in range 0x200 to 0xFFE.
+More than 32 nested calls overwrite the oldest return address.
+*/
+void
+call(State *state, unsigned short address)
+{
+	state->StackCounter = (state->StackCounter + 1) & 31;
+	state->Stack[state->StackCounter] = state->ProgramCounter;
+	state->ProgramCounter = address - 2;
+}
+
+
+/*
+0x3XYY
+skip.eq vX, value
+Skips the next instruction if vX is equal to value.
+*/
+void
+skipEqvXValue(State *state, unsigned char registerX, unsigned char value)
+{
+	if (state->V[registerX] == value) {
+		state->ProgramCounter += 2;
+	}
+}
+
+/*
+0x3XY0
+skip.eq vX, Vy
+Skips the next instruction if vX is equal to vY.
+*/
+void
+skipEqvXvY(State *state, unsigned char registerX, unsigned char registerY)
+{
+	if (state->V[registerX] == state->V[registerY]) {
+		state->ProgramCounter += 2;
+	}
+}
+
+/*
+0xEX9E
+skip.eq vX, key
+Skips the next instruction if the key with the value of the lower 4 bits of vX is being pressed.
+*/
+void
+skipvXKey(State *state, unsigned char registerX)
+{
+	if ((1 << (state->V[registerX] & 0xF)) & state->Keys) {
+		state->ProgramCounter += 2;
+	}
+}
+
+/*
+0x4XKK
+skip.ne vX, value
+Skips the next instruction if vX is not equal to value.
+*/
+void
+skipNevXValue(State *state, unsigned char registerX, unsigned char value)
+{
+	if (state->V[registerX] != value) {
+		state->ProgramCounter += 2;	
+	}	
+}
+
+/*
+0x9XY0
+skip.ne vY, vY
+Skips the next instruction if vY is not equal to vY.
+*/
+void
+skipNevXvY(State *state, unsigned char registerX, unsigned char registerY)
+{
+	if (state->V[registerX] != state->V[registerY]) {
+		state->ProgramCounter += 2;
+	}
+}
+
+/*
+0xEXA1
+skip.ne vX, key
+Skips the next instruction if the key with the value of the lower 4 bits of vX is not being pressed.
+*/
+void
+skipNevXKey(State *state, unsigned char registerX)
+{
+	if (!((1 << (state->V[registerX] & 0xF)) & state->Keys)) {
+		state->ProgramCounter += 2;
+	}
+}
+
+/*
+0x6XKK
+load vX, value
+Loads register vX with value.
+*/
+void
+loadvXValue(State *state, unsigned char registerX, unsigned char value)
+{
+	state->V[registerX] = value;
+}
+
+/*
+0xFX0A
+load vX, key
+If no key is currently pressed wait until one is, then load vX with the lowest key currently being pressed.
+Loaded key will not be registered as pressed again until it is let go and re-pressed.
+*/
+void
+loadvXKey(State *state, unsigned char registerX)
+{
+	if ((state->Keys & state->KeyMask)== 0) {
+		state->WaitingForKeyPress = 1;
+	} else {
+		state->WaitingForKeyPress = 0;
+		unsigned char lowestKey = 0;
+		while ((state->Keys & state->KeyMask) & (1 << lowestKey)) {
+			++lowestKey;
+		}		
+		state->V[registerX] = lowestKey;
+		state->KeyMask &= ~(1 << lowestKey);	
+	}
+}
+
+/*
+0x8XY0
+load vX, vY
+Loads register vX with value of vY.
+*/
+void
+loadvXvY(State *state, unsigned char registerX, unsigned char registerY)
+{
+	state->V[registerX] = state->V[registerY];
+}
+
+/*
+0xFX07
+load vX, time
+Loads register vX with the value of the time register.
+*/
+void
+loadvXTime(State *state, unsigned char registerX)
+{
+	state->V[registerX] = state->Time;
+}
+
+/*
+0xFX15
+load time, vX
+Loads the time register with the value of register vX.
+*/
+void
+loadTimevX(State *state, unsigned char registerX)
+{
+	state->Time = state->V[registerX];
+}
+
+/*
+0xFX18
+load tone, vX
+Loads the tone register with the value of register vX.
+*/
+void
+loadTonevX(State *state, unsigned char registerX)
+{
+	state->Tone = state->V[registerX];
+}
+
+/*
+0xANNN
+load i, addr
+Loads the I register with NNN.
+NNN must be in the range 0x200 to 0xFFF
+*/
+void
+loadI(State *state, unsigned short address)
+{
+	state->I = address;
+}
+
+/*
+0x7XKK
+add vX, value
+Adds KK to register vX.
+*/
+void
+addvXValue(State *state, unsigned char registerX, unsigned char value)
+{
+	state->V[registerX] += value;
+}
+
+/*
+0x8XY4
+add vX, vY
+Adds register vY to register vX.
+Register v15 is set to 1 if result overflows.
+Else register v15 is set to 0.
+*/
+void
+addvXvY(State *state, unsigned char registerX, unsigned char registerY)
+{
+	state->V[registerX] += state->V[registerY];
+}
+
+/*
+0xFX1E
+add i, vX
+Adds the value of register vX to the I register.
+*/
+void
+addIvX(State *state, unsigned char registerX)
+{
+	state->I += state->V[registerX];	
+}
+
+/*
+0x8XY1
+or vX, vY
+Bitwise ORs the value of register vY into register vX.
+*/
+void
+orvXvY(State *state, unsigned char registerX, unsigned char registerY)
+{
+	orvXvYQuirks(state, registerX, registerY, state->Quirks);
+}
+
+static inline void
+orvXvYQuirks(State *state, unsigned char registerX, unsigned char registerY, int quirks)
+{
+	state->V[registerX] |= state->V[registerY];
+
+	if (quirks & QUIRK_VF_RESET) {
+		state->V[15] = 0;
+	}
+}
+
+/*
+0x8XY2
+and vX, vY
+Bitwise ANDs the value of register vY into register vX.
+*/
+void
+andvXvY(State *state, unsigned char registerX, unsigned char registerY)
+{
+	andvXvYQuirks(state, registerX, registerY, state->Quirks);
+}
+
+static inline void
+andvXvYQuirks(State *state, unsigned char registerX, unsigned char registerY, int quirks)
+{
+	state->V[registerX] &= state->V[registerY];
+
+	if (quirks & QUIRK_VF_RESET) {
+		state->V[15] = 0;
+	}
+}
+
+/*
+0x8XY3
+xor vX, vY
+Bitwise XORs the value of register vY into register vX.
+*/
+void
+xorvXvY(State *state, unsigned char registerX, unsigned char registerY)
+{
+	xorvXvYQuirks(state, registerX, registerY, state->Quirks);
+}
+
+static inline void
+xorvXvYQuirks(State *state, unsigned char registerX, unsigned char registerY, int quirks)
+{
+	state->V[registerX] ^= state->V[registerY];
+
+	if (quirks & QUIRK_VF_RESET) {
+		state->V[15] = 0;
+	}
+}
+
+/*
+0x8XY5
+sub vX, vY
+Subtracts the value of register vY from register vX.
+Register v15 is set to 1 if the result underflows.
+Else register v15 is set to 0.
+*/
+void
+subvXvY(State *state, unsigned char registerX, unsigned char registerY)
+{
+	state->V[15] = state->V[registerX] < state->V[registerY];
+	
+	state->V[registerX] -= state->V[registerY];
+}
+
+/*
+0x8XY6
+shr vX, vY
+Shifts the value of register vX right one bit.
+With QUIRK_SHIFT_VY register vX is set to the value of register vY shifted right one bit instead.
+Register v15 is set to 1 if the value shifted was odd.
+Else register v15 is set to 0.
+*/
+void
+shrvX(State *state, unsigned char registerX, unsigned char registerY)
+{
+	shrvXQuirks(state, registerX, registerY, state->Quirks);
+}
+
+static inline void
+shrvXQuirks(State *state, unsigned char registerX, unsigned char registerY, int quirks)
+{
+	unsigned char value = state->V[quirks & QUIRK_SHIFT_VY ? registerY : registerX];
+
+	state->V[15] = value & 1;
+	
+	state->V[registerX] = value >> 1;
+}
+
+/*
+0x8XY7
+dif vX, vY
+Sets register vX to the value of register vY minus register vX.
+Register v15 is set to 1 if the result would be less than 0.
+Else register v15 is set to 0.
+*/
+void
+difvXvY(State *state, unsigned char registerX, unsigned char registerY)
+{
+	state->V[15] = state->V[registerX] > state->V[registerY];
+	
+	state->V[registerX] = state->V[registerY] - state->V[registerX];
+}
+
+/*
+0x8XYE
+shl vX, vY
+Shifts the value of register vX left one bit.
+With QUIRK_SHIFT_VY register vX is set to the value of register vY shifted left one bit instead.
+Register v15 is set to 1 if the high bit of the value shifted was set.
+Else register v15 is set to 0.
+*/
+void
+shlvX(State *state, unsigned char registerX, unsigned char registerY)
+{
+	shlvXQuirks(state, registerX, registerY, state->Quirks);
+}
+
+static inline void
+shlvXQuirks(State *state, unsigned char registerX, unsigned char registerY, int quirks)
+{
+	unsigned char value = state->V[quirks & QUIRK_SHIFT_VY ? registerY : registerX];
+
+	state->V[15] = value >> 7;
+
+	state->V[registerX] = value << 1;
+}
+
+/*
+0xCXKK
+rnd vX, mask
+Sets register vX to the bitwise AND of a random number and KK.
+*/
+void
+rndvXMask(State *state, unsigned char registerX, unsigned char mask)
+{
+	state->V[registerX] = (unsigned char)rand() & mask;
+}
+
+/*
+0XDXYN
+draw xY, vY, rows
+Draws an image to the display buffer.
+The image is 8 pixels wide and N pixels long.
+The image is pointed to by the I register.
+The top left corner of the image will be at (register vX, register vY).
+Pixels are blitted to the display buffer using XOR.
+If this causes one or more pixels to be erased register v15 is set to 1.
+Else register v15 is set to 0.
+N must be in the range 1 to 15.
+The top left corner wraps around the display, the rest of the image is clipped at its edges or with QUIRK_WRAP wraps around them.
+*/
+void
+drawvXvYRows(State *state, unsigned char registerX, unsigned char registerY, unsigned char rows)
+{
+	drawSprite(state, registerX, registerY, rows, 0, state->Quirks);
+}
+
+/*
+0xFX29
+hex vX
+Points the I register to an image of a hex character representing the low 4 bits of register vX.
+The image is 4 pixels wide and 5 pixels long.
+*/
+void
+hexvX(State *state, unsigned char registerX)
+{
+	state->I = (state->V[registerX] & 0xF) << 4;
+}
+
+/*
+0xFX33
+bcd vX
+Stores a BCD(Binary Coded Decimal) representation of the value of register vX into memory starting at the byte pointed to by the I register. 
+Most significant digit is loaded first.
+*/
+void
+bcdvX(State *state, unsigned char registerX)
+{
+	writeMemory(state, state->I, state->V[registerX] / 100);
+	writeMemory(state, state->I+1, (state->V[registerX] % 100) / 10);
+	writeMemory(state, state->I+2, (state->V[registerX] % 10));
+}
+
+/*
+0xFX55
+save vX
+Stores the values of registers v0 to vX in memory starting at the byte pointed to by the I register.
+*/
+void
+savevX(State *state, unsigned char registerX)
+{
+	savevXQuirks(state, registerX, state->Quirks);
+}
+
+static inline void
+savevXQuirks(State *state, unsigned char registerX, int quirks)
+{
+	for (int i = 0; i <= registerX; i++) {
+		writeMemory(state, state->I + i, state->V[i]);
+	}
+
+	if (quirks & QUIRK_MEMORY_INCREMENT) {
+		state->I += registerX + 1;
+	}
+}
+
+/*
+0xFX65
+restore vX
+Loads the values in memory starting at the byte pointed to by the I register into registers v0 to vX.
+*/
+void
+restorevX(State *state, unsigned char registerX)
+{
+	restorevXQuirks(state, registerX, state->Quirks);
+}
+
+static inline void
+restorevXQuirks(State *state, unsigned char registerX, int quirks)
+{
+	for (int i = 0; i <= registerX; i++) {
+		state->V[i] = readMemory(state, state->I + i);
+	}
+
+	if (quirks & QUIRK_MEMORY_INCREMENT) {
+		state->I += registerX + 1;
+	}
+}
+
+/*
+DEBUG OPCODE
+0x001X
+exit value
+Causes the program to exit with the value of X.
+X must be in the range 0 to 1.
+*/
+int
+programExitValue(State *state, unsigned char value)
+{
+	return value;
+}
+
+/*
+Super Chip8 Definitions
+*/
+// TODO
+/*
+0x00Cn
+scdown n
+Scrolls the display buffer down by n pixels.
+*/
+void
+scrollDownN(State *state, unsigned char n)
+{
+/*
+	Possibly delay execution of this opcode until drawing in Low mode?
+*/
+	if (state->DisplayIsHigh) {
+		/*
+			Copy DisplayBuffer lines that will be kept to their new spots.
+			Bottom up so no line is overwritten before it is copied.
+		*/
+		for (int i = 63 - n; i >= 0; i--) {
+			state->DisplayBuffer.High[0][i+n] = state->DisplayBuffer.High[0][i];
+			state->DisplayBuffer.High[1][i+n] = state->DisplayBuffer.High[1][i];
+		}
+		/*
+			Zero copied lines.
+		*/
+		memset(state->DisplayBuffer.High[0], 0, n * sizeof(unsigned long long));
+		memset(state->DisplayBuffer.High[1], 0, n * sizeof(unsigned long long));
+	} else {
+		/*
+			Copy DisplayBuffer lines that will be kept to their new spots.
+			Bottom up so no line is overwritten before it is copied.
+		*/
+		for (int i = 31 - n; i >= 0; i--) {
+			state->DisplayBuffer.Low[i+n] = state->DisplayBuffer.Low[i];
+		}
+		/*
+			Zero copied lines.
+		*/
+		memset(state->DisplayBuffer.Low, 0, n * sizeof(unsigned long long));
+	}	
+	state->DirtyRows = ~0ULL;
+}
+
+/*
+0x00FB
+scright
+Scrolls the display buffer right 4 pixels.
+*/
+void
+scrollRight(State *state)
+{
+/*
+	Possibly delay execution of this opcode until drawing in Low mode?
+*/
+	if (state->DisplayIsHigh) {
+		for (int i = 0; i < 64; i++) {
+			/*
+				Shift the second line over
+			*/
+			state->DisplayBuffer.High[1][i] >>= 4;
+			/*
+				Copy last 4 bits of first half into first 4 bits of second half
+			*/
+			state->DisplayBuffer.High[1][i] |= (state->DisplayBuffer.High[0][i] & 0xf) << 60;
+			/*
+				Shift the first line over.
+			*/
+			state->DisplayBuffer.High[0][i] >>= 4;	
+		}
+	} else {
+		for (int i = 0; i < 32; i++) {
+			state->DisplayBuffer.Low[i] >>= 4;
+		}
+	}
+	state->DirtyRows = ~0ULL;
+}
+
+/*
+0x00FC
+scleft
+Scrolls the display buffer left 4 pixels.
+*/
+void
+scrollLeft(State *state)
+{
+/*
+	Possibly delay execution of this opcode until drawing in Low mode?
+*/
+	if (state->DisplayIsHigh) {
+		for (int i = 0; i < 64; i++) {
+			/*
+				Shift the first line over
+			*/
+			state->DisplayBuffer.High[0][i] <<= 4;
+			/*
+				Copy first 4 bits of second half into last 4 bits of first half
+			*/
+			state->DisplayBuffer.High[0][i] |= state->DisplayBuffer.High[1][i] >> 60;
+			/*
+				Shift the second line over.
+			*/
+			state->DisplayBuffer.High[1][i] <<= 4;	
+		}
+	} else {
+		for (int i = 0; i < 32; i++) {
+			state->DisplayBuffer.Low[i] <<= 4;
+		}
+	}
+	state->DirtyRows = ~0ULL;
+}
+
+/*
+0x00FE
+low
+Sets the display buffer to the low resolution (64 x 32).
+This is the default state.
+*/
+void
+displayBufferLow(State *state)
+{
+	state->DisplayIsHigh = 0;	
+}
+
+/*
+0x00FF
+high
+Sets the display buffer to the high resolution (128 x 64).
+*/
+void
+displayBufferHigh(State *state)
+{
+	state->DisplayIsHigh = 1;
+}
+
+/*
+0xDXY0
+xdraw vX, vY
+Draws an image to the display buffer.
+The image is 16 pixels wide and 16 pixels long.
+The image is pointed to by the I register.
+The top left corner of the image will be at (register vX, register vY).
+Pixels are blitted to the display buffer using XOR.
+If this causes one or more pixels to be erased register v15 is set to 1.
+Else register v15 is set to 0.
+The image is clipped or wrapped like draw vX, vY, rows.
+*/
+void
+drawvXvY(State *state, unsigned char registerX, unsigned char registerY)
+{
+	drawSprite(state, registerX, registerY, 16, 1, state->Quirks);
+}
+
+/*
+Draws rows rows of an image 8 pixels wide, or 16 if wide is set, for both draw opcodes.
+Rows are shifted into place as 64 bit words, with the pixels that run past the right edge of the word they start in spilling into the next one.
+Clipping and wrapping are decided by masks and row counts worked out once per sprite, and every row and word index is masked to the display, so nothing is written outside it.
+*/
+static inline void
+drawSprite(State *state, unsigned char registerX, unsigned char registerY, int rows, int wide, int quirks)
+{
+	int high = state->DisplayIsHigh;
+	int width = high ? 128 : 64;
+	int height = high ? 64 : 32;
+	int x = state->V[registerX] & (width - 1);
+	int y = state->V[registerY] & (height - 1);
+	int half = x >> 6;
+	int shift = x & 63;
+	int step = wide ? 2 : 1;
+	unsigned long long erased = 0;
+	/*
+	Pixels spilling out of the left half land in the right half, anything else spilling has run off the right edge.
+	*/
+	unsigned long long keepSpill = (quirks & QUIRK_WRAP) || (high && half == 0) ? ~0ULL : 0;
+
+	if (!(quirks & QUIRK_WRAP) && rows > height - y) {
+		rows = height - y;
+	}
+
+	for (int i = 0; i < rows; i++) {
+		int row = (y + i) & (height - 1);
+		unsigned short address = state->I + i * step;
+		unsigned long long bits = (unsigned long long)readMemory(state, address) << 56;
+		unsigned long long line;
+		unsigned long long spill;
+
+		if (wide) {
+			bits |= (unsigned long long)readMemory(state, address + 1) << 48;
+		}
+
+		line = bits >> shift;
+		spill = (bits << (63 - shift) << 1) & keepSpill;
+
+		if (high) {
+			erased |= (state->DisplayBuffer.High[half][row] & line) | (state->DisplayBuffer.High[half ^ 1][row] & spill);
+			state->DisplayBuffer.High[half][row] ^= line;
+			state->DisplayBuffer.High[half ^ 1][row] ^= spill;
+		} else {
+			line |= spill;
+			erased |= state->DisplayBuffer.Low[row] & line;
+			state->DisplayBuffer.Low[row] ^= line;
+		}
+		state->DirtyRows |= 1ULL << row;
+	}
+
+	state->V[15] = erased != 0;
+	state->Draws++;
+	state->Collisions += erased != 0;
+}
+
+/*
+0x00FD
+exit
+Causes the program to exit with a successful exit status.
+*/
+int
+programExit(State *state) {
+	return 0;
+}
+
+/*
+Memory Definitions
+*/
+
+Page *
+writablePage(State *state, int page)
+{
+	Page *shared = state->Memory[page];
+	Page *copy;
+
+	if (__atomic_load_n(&shared->References, __ATOMIC_ACQUIRE) == 1) {
+		return shared;
+	}
+
+	copy = malloc(sizeof(Page));
+	if (copy == NULL) {
+		return NULL;
+	}
+
+	copy->References = 1;
+	memcpy(copy->Bytes, shared->Bytes, sizeof(copy->Bytes));
+
+	state->Memory[page] = copy;
+	if (__atomic_sub_fetch(&shared->References, 1, __ATOMIC_ACQ_REL) == 0) {
+		free(shared);
+	}
+
+	return copy;
+}
+
+void
+releaseMemory(State *state)
+{
+	for (int i = 0; i < MEMORY_PAGES; i++) {
+		if (__atomic_sub_fetch(&state->Memory[i]->References, 1, __ATOMIC_ACQ_REL) == 0) {
+			free(state->Memory[i]);
+		}
+		state->Memory[i] = NULL;
+	}
+}
+
+void
+shareMemory(State *into, const State *from)
+{
+	for (int i = 0; i < MEMORY_PAGES; i++) {
+		__atomic_add_fetch(&from->Memory[i]->References, 1, __ATOMIC_RELAXED);
+	}
+
+	releaseMemory(into);
+
+	for (int i = 0; i < MEMORY_PAGES; i++) {
+		into->Memory[i] = from->Memory[i];
+	}
+}
+
+/*
+Interpreter Definitions
+*/
+
+/*
+Resets state and points its memory at the shared hex character images and zero pages.
+*/
+void
+initMachineState(State *state)
+{
+	/*
+	Init state
+	*/
+	state->ProgramCounter = 0x200;
+	state->StackCounter = -1;
+	memset(state->DisplayBuffer.High, 0, sizeof(state->DisplayBuffer.High));	
+	state->DisplayIsHigh = 0;
+	state->DirtyRows = ~0ULL;
+	state->Quirks = QUIRKS_DEFAULT;
+	state->Engine = CHIP8_ENGINE_SWITCH;
+	state->Time = 0;
+	state->Tone = 0;
+	state->I = 0;
+	state->Keys = 0;
+	state->KeyMask = 0xFFFF;
+	state->WaitingForKeyPress = 0;
+	state->ExitValue = 0;
+	state->FrameTick = 0;
+	state->TicksPerFrame = 10;
+	state->Timing = CHIP8_TIMING_FAST;
+	state->AtBreakpoint = 0;
+	memset(state->Breakpoints, 0, sizeof(state->Breakpoints));
+	memset(state->Watchpoints, 0, sizeof(state->Watchpoints));
+	state->WatchRegisters = 0;
+	state->Instructions = 0;
+	state->Draws = 0;
+	state->Collisions = 0;
+	memset(state->V, 0, sizeof(state->V));
+	memset(state->Stack, 0, sizeof(state->Stack));
+
+	/*
+	Memory starts out as the shared font page followed by shared zero pages.
+	*/
+	state->Memory[0] = &FontPage;
+	__atomic_add_fetch(&FontPage.References, 1, __ATOMIC_RELAXED);
+	for (int i = 1; i < MEMORY_PAGES; i++) {
+		state->Memory[i] = &ZeroPage;
+	}
+	__atomic_add_fetch(&ZeroPage.References, MEMORY_PAGES - 1, __ATOMIC_RELAXED);
+}
+
+/*
+Returns the machine cycles opcode takes with the COSMAC timing model.
+frameTick is where in the frame it starts, draws wait out the rest of the frame for the display interrupt.
+The wait depends only on the frame, so a program runs the same however finely it is stepped.
+*/
+static inline int
+opcodeCycles(unsigned short opcode, int frameTick, int ticksPerFrame)
+{
+	int cycles = FETCH_CYCLES + GroupCycles[opcode >> 12];
+	int remaining;
+
+	switch (opcode & 0xF000) {
+	case 0xD000:
+		cycles += (opcode & 0xF) == 0 ? 32 * ROW_CYCLES : (opcode & 0xF) * ROW_CYCLES;
+		remaining = ticksPerFrame - frameTick % ticksPerFrame;
+		return cycles > remaining ? cycles : remaining;
+	case 0xF000:
+		switch (opcode & 0xFF) {
+		case 0x33:
+			cycles += 3 * REGISTER_CYCLES;
+			break;
+		case 0x55:
+		case 0x65:
+			cycles += (((opcode & 0xF00) >> 8) + 1) * REGISTER_CYCLES;
+			break;
+		}
+		break;
+	}
+
+	return cycles;
+}
+
+static void
+watchBefore(const State *state, unsigned short opcode, Watch *watch)
+{
+	memcpy(watch->V, state->V, sizeof(watch->V));
+	watch->I = state->I;
+	watch->StoreAddress = state->I;
+
+	switch (opcode & 0xF0FF) {
+	case 0xF033:
+		watch->StoreLength = 3;
+		break;
+	case 0xF055:
+		watch->StoreLength = ((opcode & 0xF00) >> 8) + 1;
+		break;
+	default:
+		watch->StoreLength = 0;
+		break;
+	}
+}
+
+/*
+Returns 1 if the instruction stored to a watched address or changed a watched register, and sets WatchHit to the address or -1.
+*/
+static int
+watchAfter(State *state, const Watch *watch)
+{
+	for (int i = 0; i < watch->StoreLength; i++) {
+		unsigned short address = (watch->StoreAddress + i) & 0xFFF;
+
+		if (state->Watchpoints[address >> 3] & (1 << (address & 7))) {
+			state->WatchHit = address;
+			return 1;
+		}
+	}
+
+	state->WatchHit = -1;
+
+	for (int i = 0; i < 16; i++) {
+		if ((state->WatchRegisters & (1 << i)) && state->V[i] != watch->V[i]) {
+			return 1;
+		}
+	}
+
+	if ((state->WatchRegisters & WATCH_I) && state->I != watch->I) {
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+One interpreter loop per profile, one reading the quirks from state for any other combination, one counting cycles, and one for debugging.
+*/
+#define CORE_NAME runDefault
+#define CORE_QUIRKS QUIRKS_DEFAULT
+#include "core.h"
+
+#define CORE_NAME runChip8
+#define CORE_QUIRKS QUIRKS_CHIP8
+#include "core.h"
+
+#define CORE_NAME runSchip
+#define CORE_QUIRKS QUIRKS_SCHIP
+#include "core.h"
+
+#define CORE_NAME runXochip
+#define CORE_QUIRKS QUIRKS_XOCHIP
+#include "core.h"
+
+#define CORE_NAME runAnyQuirks
+#define CORE_QUIRKS (state->Quirks)
+#include "core.h"
+
+#define CORE_NAME runTimed
+#define CORE_QUIRKS (state->Quirks)
+#define CORE_TIMED 1
+#include "core.h"
+
+#define CORE_NAME runDebug
+#define CORE_QUIRKS (state->Quirks)
+#define CORE_TIMED (state->Timing)
+#define CORE_DEBUG 1
+#include "core.h"
+
+/*
+Table Engine Definitions
+Every handler decodes its own operands and reads the quirks from state.
+*/
+
+static int
+opNone(State *state, unsigned short opcode)
+{
+	return 0;
+}
+
+static int
+opExitValue(State *state, unsigned short opcode)
+{
+	state->ExitValue = programExitValue(state, opcode & 0xF);
+	return CHIP8_EXIT;
+}
+
+static int
+opScrollDown(State *state, unsigned short opcode)
+{
+	scrollDownN(state, opcode & 0xF);
+	return 0;
+}
+
+static int
+opClear(State *state, unsigned short opcode)
+{
+	clearScreen(state);
+	return 0;
+}
+
+static int
+opReturn(State *state, unsigned short opcode)
+{
+	subroutineReturn(state);
+	return 0;
+}
+
+static int
+opCompatability(State *state, unsigned short opcode)
+{
+	compatability(state);
+	return 0;
+}
+
+static int
+opScrollRight(State *state, unsigned short opcode)
+{
+	scrollRight(state);
+	return 0;
+}
+
+static int
+opScrollLeft(State *state, unsigned short opcode)
+{
+	scrollLeft(state);
+	return 0;
+}
+
+static int
+opExit(State *state, unsigned short opcode)
+{
+	state->ExitValue = programExit(state);
+	return CHIP8_EXIT;
+}
+
+static int
+opLow(State *state, unsigned short opcode)
+{
+	displayBufferLow(state);
+	return 0;
+}
+
+static int
+opHigh(State *state, unsigned short opcode)
+{
+	displayBufferHigh(state);
+	return 0;
+}
+
+static int
+opJump(State *state, unsigned short opcode)
+{
+	jump(state, opcode & 0xFFF);
+	return 0;
+}
+
+static int
+opCall(State *state, unsigned short opcode)
+{
+	call(state, opcode & 0xFFF);
+	return 0;
+}
+
+static int
+opSkipEqvXvY(State *state, unsigned short opcode)
+{
+	skipEqvXvY(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+	return 0;
+}
+
+static int
+opSkipEqvXValue(State *state, unsigned short opcode)
+{
+	skipEqvXValue(state, (opcode & 0xF00) >> 8, opcode & 0xFF);
+	return 0;
+}
+
+static int
+opSkipNevXValue(State *state, unsigned short opcode)
+{
+	skipNevXValue(state, (opcode & 0xF00) >> 8, opcode & 0xFF);
+	return 0;
+}
+
+static int
+opLoadvXValue(State *state, unsigned short opcode)
+{
+	loadvXValue(state, (opcode & 0xF00) >> 8, opcode & 0xFF);
+	return 0;
+}
+
+static int
+opAddvXValue(State *state, unsigned short opcode)
+{
+	addvXValue(state, (opcode & 0xF00) >> 8, opcode & 0xFF);
+	return 0;
+}
+
+static int
+opLoadvXvY(State *state, unsigned short opcode)
+{
+	loadvXvY(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+	return 0;
+}
+
+static int
+opOrvXvY(State *state, unsigned short opcode)
+{
+	orvXvYQuirks(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, state->Quirks);
+	return 0;
+}
+
+static int
+opAndvXvY(State *state, unsigned short opcode)
+{
+	andvXvYQuirks(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, state->Quirks);
+	return 0;
+}
+
+static int
+opXorvXvY(State *state, unsigned short opcode)
+{
+	xorvXvYQuirks(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, state->Quirks);
+	return 0;
+}
+
+static int
+opAddvXvY(State *state, unsigned short opcode)
+{
+	addvXvY(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+	return 0;
+}
+
+static int
+opSubvXvY(State *state, unsigned short opcode)
+{
+	subvXvY(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+	return 0;
+}
+
+static int
+opShrvX(State *state, unsigned short opcode)
+{
+	shrvXQuirks(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, state->Quirks);
+	return 0;
+}
+
+static int
+opDifvXvY(State *state, unsigned short opcode)
+{
+	difvXvY(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+	return 0;
+}
+
+static int
+opShlvX(State *state, unsigned short opcode)
+{
+	shlvXQuirks(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, state->Quirks);
+	return 0;
+}
+
+static int
+opSkipNevXvY(State *state, unsigned short opcode)
+{
+	skipNevXvY(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+	return 0;
+}
+
+static int
+opLoadI(State *state, unsigned short opcode)
+{
+	loadI(state, opcode & 0xFFF);
+	return 0;
+}
+
+static int
+opJumpv0(State *state, unsigned short opcode)
+{
+	jumpv0Quirks(state, opcode & 0xFFF, state->Quirks);
+	return 0;
+}
+
+static int
+opRndvXMask(State *state, unsigned short opcode)
+{
+	rndvXMask(state, (opcode & 0xF00) >> 8, opcode & 0xFF);
+	return 0;
+}
+
+static int
+opXdrawvXvY(State *state, unsigned short opcode)
+{
+	drawSprite(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, 16, 1, state->Quirks);
+	return CHIP8_DRAW;
+}
+
+static int
+opDrawSkipvXKey(State *state, unsigned short opcode)
+{
+	drawSprite(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, opcode & 0xF, 0, state->Quirks);
+	skipvXKey(state, (opcode & 0xF00) >> 8);
+	return CHIP8_DRAW;
+}
+
+static int
+opDrawSkipNevXKey(State *state, unsigned short opcode)
+{
+	drawSprite(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, opcode & 0xF, 0, state->Quirks);
+	skipNevXKey(state, (opcode & 0xF00) >> 8);
+	return CHIP8_DRAW;
+}
+
+static int
+opDrawvXvY(State *state, unsigned short opcode)
+{
+	drawSprite(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, opcode & 0xF, 0, state->Quirks);
+	return CHIP8_DRAW;
+}
+
+static int
+opSkipvXKey(State *state, unsigned short opcode)
+{
+	skipvXKey(state, (opcode & 0xF00) >> 8);
+	return 0;
+}
+
+static int
+opSkipNevXKey(State *state, unsigned short opcode)
+{
+	skipNevXKey(state, (opcode & 0xF00) >> 8);
+	return 0;
+}
+
+static int
+opLoadvXTime(State *state, unsigned short opcode)
+{
+	loadvXTime(state, (opcode & 0xF00) >> 8);
+	return 0;
+}
+
+static int
+opLoadvXKey(State *state, unsigned short opcode)
+{
+	loadvXKey(state, (opcode & 0xF00) >> 8);
+	return state->WaitingForKeyPress ? CHIP8_KEY_WAIT : 0;
+}
+
+static int
+opLoadTimevX(State *state, unsigned short opcode)
+{
+	loadTimevX(state, (opcode & 0xF00) >> 8);
+	return 0;
+}
+
+static int
+opLoadTonevX(State *state, unsigned short opcode)
+{
+	loadTonevX(state, (opcode & 0xF00) >> 8);
+	return CHIP8_TONE;
+}
+
+static int
+opAddIvX(State *state, unsigned short opcode)
+{
+	addIvX(state, (opcode & 0xF00) >> 8);
+	return 0;
+}
+
+static int
+opHexvX(State *state, unsigned short opcode)
+{
+	hexvX(state, (opcode & 0xF00) >> 8);
+	return 0;
+}
+
+static int
+opBcdvX(State *state, unsigned short opcode)
+{
+	bcdvX(state, (opcode & 0xF00) >> 8);
+	return 0;
+}
+
+static int
+opSavevX(State *state, unsigned short opcode)
+{
+	savevXQuirks(state, (opcode & 0xF00) >> 8, state->Quirks);
+	return 0;
+}
+
+static int
+opRestorevX(State *state, unsigned short opcode)
+{
+	restorevXQuirks(state, (opcode & 0xF00) >> 8, state->Quirks);
+	return 0;
+}
+
+/*
+Finds the first description matching every opcode.
+Machines on other threads may be building it at the same time, they all store the same values.
+*/
+static void
+buildDecode(void)
+{
+	if (__atomic_load_n(&DecodeReady, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+
+	for (int opcode = 0; opcode < 0x10000; opcode++) {
+		unsigned char handler = 0;
+
+		for (size_t i = 1; i < sizeof(Handlers) / sizeof(Handlers[0]); i++) {
+			if ((opcode & Handlers[i].Mask) == Handlers[i].Match) {
+				handler = i;
+				break;
+			}
+		}
+		__atomic_store_n(&Decode[opcode], handler, __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&DecodeReady, 1, __ATOMIC_RELEASE);
+}
+
+/*
+The interpreter loop of the table engine.
+Stops like the switch loops, but reads the quirks from state so it never has to leave for the compatability opcode.
+*/
+static int
+runTable(State *state, int frameTick, int ticks, int events, int *executed)
+{
+	int i;
+
+	for (i = 0; i < ticks; i++) {
+		unsigned short opcode = (readMemory(state, state->ProgramCounter) << 8) | readMemory(state, state->ProgramCounter + 1);
+		int event;
+
+		if (state->Timing) {
+			i += opcodeCycles(opcode, frameTick + i, state->TicksPerFrame) - 1;
+			state->Instructions++;
+		}
+
+		event = Handlers[Decode[opcode]].Run(state, opcode);
+
+		if (event == CHIP8_EXIT) {
+			*executed = i + 1;
+			return CHIP8_EXIT;
+		}
+
+		if (!state->WaitingForKeyPress) {
+			state->ProgramCounter += 2;
+		}
+
+		if (event & events) {
+			*executed = i + 1;
+			return event;
+		}
+	}
+
+	*executed = i;
+
+	return CHIP8_CYCLES;
+}
+
+int
+runUntil(State *state, int ticks, int events, int *executed)
+{
+	int event;
+	int ran;
+
+	*executed = 0;
+
+	if (events & (CHIP8_BREAKPOINT | CHIP8_WATCH)) {
+		/*
+		Breakpoints and watchpoints are only checked by the debugging loop, so the others run without them.
+		*/
+		do {
+			event = runDebug(state, state->FrameTick + *executed, ticks - *executed, events, &ran);
+			*executed += ran;
+		} while (event == CORE_QUIRKS_CHANGED);
+	} else if (state->Engine == CHIP8_ENGINE_TABLE) {
+		state->AtBreakpoint = 0;
+		event = runTable(state, state->FrameTick, ticks, events, executed);
+	} else if (state->Timing) {
+		state->AtBreakpoint = 0;
+		event = runTimed(state, state->FrameTick, ticks, events, executed);
+	} else {
+		state->AtBreakpoint = 0;
+
+		/*
+		The compatability opcode changes the quirks and leaves the loop, which is picked again for what is left of ticks.
+		*/
+		do {
+			switch (state->Quirks) {
+			case QUIRKS_DEFAULT:
+				event = runDefault(state, state->FrameTick + *executed, ticks - *executed, events, &ran);
+				break;
+			case QUIRKS_CHIP8:
+				event = runChip8(state, state->FrameTick + *executed, ticks - *executed, events, &ran);
+				break;
+			case QUIRKS_SCHIP:
+				event = runSchip(state, state->FrameTick + *executed, ticks - *executed, events, &ran);
+				break;
+			case QUIRKS_XOCHIP:
+				event = runXochip(state, state->FrameTick + *executed, ticks - *executed, events, &ran);
+				break;
+			default:
+				event = runAnyQuirks(state, state->FrameTick + *executed, ticks - *executed, events, &ran);
+				break;
+			}
+			*executed += ran;
+		} while (event == CORE_QUIRKS_CHANGED);
+	}
+
+	/*
+	Without a timing model every tick is an instruction, the loops that count cycles count instructions themselves.
+	*/
+	if (!state->Timing) {
+		state->Instructions += *executed;
+	}
+
+	return event;
+}
+
+int
+runTicks(State *state, int ticks, int *executed)
+{
+	if (runUntil(state, ticks, CHIP8_TONE, executed) == CHIP8_EXIT) {
+		return state->ExitValue;
+	}
+
+	return -1;
+}
+
+/*
+Library Definitions
+*/
+
+State *
+chip8Create(void)
+{
+	State *state = malloc(sizeof(State));
+
+	if (state != NULL) {
+		initMachineState(state);
+	}
+
+	return state;
+}
+
+void
+chip8Destroy(State *state)
+{
+	if (state != NULL) {
+		releaseMemory(state);
+	}
+
+	free(state);
+}
+
+State *
+chip8Clone(const State *state)
+{
+	State *clone = malloc(sizeof(State));
+
+	if (clone != NULL) {
+		initMachineState(clone);
+		chip8CloneInto(clone, state);
+	}
+
+	return clone;
+}
+
+void
+chip8CloneInto(State *into, const State *from)
+{
+	if (into == from) {
+		return;
+	}
+
+	/*
+	Take references to from's pages before releasing into's, they may be the same pages.
+	*/
+	for (int i = 0; i < MEMORY_PAGES; i++) {
+		__atomic_add_fetch(&from->Memory[i]->References, 1, __ATOMIC_RELAXED);
+	}
+
+	releaseMemory(into);
+	*into = *from;
+}
+
+int
+chip8LoadRom(State *state, const unsigned char *program, size_t size)
+{
+	Page *owned[MEMORY_PAGES] = { NULL };
+
+	if (size > ROM_MAX_SIZE) {
+		return -1;
+	}
+
+	/*
+	Pages the machine owns alone are cleared and kept instead of being freed and allocated again, so hosts that load many programs into one machine, like fuzzers, rarely allocate.
+	A copy of the font page is given up for the shared one.
+	*/
+	for (int i = 1; i < MEMORY_PAGES; i++) {
+		if (__atomic_load_n(&state->Memory[i]->References, __ATOMIC_ACQUIRE) == 1) {
+			owned[i] = state->Memory[i];
+			__atomic_add_fetch(&owned[i]->References, 1, __ATOMIC_RELAXED);
+		}
+	}
+
+	releaseMemory(state);
+	initMachineState(state);
+
+	for (int i = 1; i < MEMORY_PAGES; i++) {
+		if (owned[i] != NULL) {
+			memset(owned[i]->Bytes, 0, sizeof(owned[i]->Bytes));
+			state->Memory[i] = owned[i];
+			__atomic_sub_fetch(&ZeroPage.References, 1, __ATOMIC_RELAXED);
+		}
+	}
+
+	for (size_t offset = 0; offset < size;) {
+		unsigned int address = ROM_START + offset;
+		size_t length = MEMORY_PAGE_SIZE - address % MEMORY_PAGE_SIZE;
+		Page *page = writablePage(state, address / MEMORY_PAGE_SIZE);
+
+		if (page == NULL) {
+			return -1;
+		}
+
+		if (length > size - offset) {
+			length = size - offset;
+		}
+
+		memcpy(page->Bytes + address % MEMORY_PAGE_SIZE, program + offset, length);
+		offset += length;
+	}
+
+	return 0;
+}
+
+int
+chip8RunCycles(State *state, int cycles)
+{
+	int executed;
+	int event = runUntil(state, cycles, 0, &executed);
+
+	/*
+	Keeps the place in the frame, the host ticks the timers.
+	*/
+	state->FrameTick = (state->FrameTick + executed) % state->TicksPerFrame;
+
+	if (event == CHIP8_EXIT) {
+		return state->ExitValue;
+	}
+
+	return -1;
+}
+
+int
+chip8RunUntil(State *state, int cycles, int events)
+{
+	while (cycles > 0) {
+		int budget = state->TicksPerFrame - state->FrameTick;
+		int executed;
+		int event;
+
+		if (budget > cycles) {
+			budget = cycles;
+		}
+
+		event = runUntil(state, budget, events, &executed);
+		cycles -= executed;
+		state->FrameTick += executed;
+
+		if (state->FrameTick >= state->TicksPerFrame) {
+			/*
+			Cycles an instruction ran over the frame by come out of the next one.
+			*/
+			state->FrameTick -= state->TicksPerFrame;
+			chip8TickTimers(state);
+
+			if (events & CHIP8_FRAME) {
+				event |= CHIP8_FRAME;
+			}
+		}
+
+		if (event != CHIP8_CYCLES) {
+			return event;
+		}
+	}
+
+	return CHIP8_CYCLES;
+}
+
+void
+chip8SetQuirks(State *state, int quirks)
+{
+	state->Quirks = quirks;
+}
+
+void
+chip8SetEngine(State *state, int engine)
+{
+	if (engine == CHIP8_ENGINE_TABLE) {
+		buildDecode();
+	}
+
+	state->Engine = engine;
+}
+
+void
+chip8SetTiming(State *state, int timing)
+{
+	state->Timing = timing;
+	state->TicksPerFrame = timing == CHIP8_TIMING_COSMAC ? COSMAC_CYCLES_PER_FRAME : 10;
+	state->FrameTick = 0;
+}
+
+int
+chip8FindTiming(const char *name)
+{
+	for (size_t i = 0; i < sizeof(Timings) / sizeof(Timings[0]); i++) {
+		if (strcmp(Timings[i].Name, name) == 0) {
+			return Timings[i].Timing;
+		}
+	}
+
+	return -1;
+}
+
+int
+chip8FindEngine(const char *name)
+{
+	for (size_t i = 0; i < sizeof(Engines) / sizeof(Engines[0]); i++) {
+		if (strcmp(Engines[i].Name, name) == 0) {
+			return Engines[i].Engine;
+		}
+	}
+
+	return -1;
+}
+
+int
+chip8FindQuirks(const char *name)
+{
+	for (size_t i = 0; i < sizeof(Profiles) / sizeof(Profiles[0]); i++) {
+		if (strcmp(Profiles[i].Name, name) == 0) {
+			return Profiles[i].Quirks;
+		}
+	}
+
+	return -1;
+}
+
+void
+chip8SetBreakpoint(State *state, unsigned short address, int enabled)
+{
+	address &= 0xFFF;
+
+	if (enabled) {
+		state->Breakpoints[address >> 3] |= 1 << (address & 7);
+	} else {
+		state->Breakpoints[address >> 3] &= ~(1 << (address & 7));
+	}
+}
+
+void
+chip8SetWatchpoint(State *state, unsigned short address, unsigned short length, int enabled)
+{
+	for (int i = 0; i < length; i++) {
+		unsigned short byte = (address + i) & 0xFFF;
+
+		if (enabled) {
+			state->Watchpoints[byte >> 3] |= 1 << (byte & 7);
+		} else {
+			state->Watchpoints[byte >> 3] &= ~(1 << (byte & 7));
+		}
+	}
+}
+
+void
+chip8WatchRegisters(State *state, int registers)
+{
+	state->WatchRegisters = registers;
+}
+
+void
+chip8TickTimers(State *state)
+{
+	if (state->WaitingForKeyPress) {
+		return;
+	}
+
+	if (state->Time > 0) {
+		state->Time -= 1;
+	}
+
+	if (state->Tone > 0) {
+		state->Tone -= 1;
+	}
+}
+
+void
+chip8SetKeys(State *state, unsigned short keys)
+{
+	state->Keys = keys;
+
+	/*
+	Set KeyMask for released keys
+	*/
+	state->KeyMask |= ~(state->Keys);
+}
+
+const Display *
+chip8Framebuffer(const State *state, int *isHigh)
+{
+	if (isHigh != NULL) {
+		*isHigh = state->DisplayIsHigh;
+	}
+
+	return &state->DisplayBuffer;
+}
@@ -0,0 +1,812 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+The Chip8 machine and its opcodes.
+Every function works on the machine it is passed, so any number of machines can run side by side.
+Depends only on the C library, the library functions at the end are what a host embedding the machine needs.
+*/
+
+#ifndef CHIP8_H
+#define CHIP8_H
+
+#include <stddef.h>
+
+#include "display.h"
+
+/*
+Events that stop runUntil and chip8RunUntil.
+CHIP8_CYCLES means the cycles ran out before any of the requested events happened.
+*/
+enum {
+	CHIP8_CYCLES = 0,
+	CHIP8_FRAME = 1 << 0,
+	CHIP8_DRAW = 1 << 1,
+	CHIP8_KEY_WAIT = 1 << 2,
+	CHIP8_TONE = 1 << 3,
+	CHIP8_BREAKPOINT = 1 << 4,
+	CHIP8_EXIT = 1 << 5,
+	CHIP8_WATCH = 1 << 6
+};
+
+/*
+Watches I in WatchRegisters, next to v0 to v15 in bits 0 to 15.
+*/
+#define WATCH_I (1 << 16)
+
+/*
+Quirks, behaviors that interpreters of different eras disagree on.
+A set bit selects the behavior described.
+*/
+enum {
+	/*
+	save and restore advance I past the last register.
+	*/
+	QUIRK_MEMORY_INCREMENT = 1 << 0,
+	/*
+	shr and shl shift vY into vX instead of shifting vX in place.
+	*/
+	QUIRK_SHIFT_VY = 1 << 1,
+	/*
+	or, and and xor set v15 to 0.
+	*/
+	QUIRK_VF_RESET = 1 << 2,
+	/*
+	jump addr, v0 jumps to NNN plus vX, where X is the high nibble of NNN.
+	*/
+	QUIRK_JUMP_VX = 1 << 3,
+	/*
+	Images wrap around the edges of the display instead of being clipped.
+	*/
+	QUIRK_WRAP = 1 << 4
+};
+
+/*
+Quirk profiles.
+QUIRKS_DEFAULT is how this interpreter has always behaved and what every machine starts with.
+*/
+#define QUIRKS_DEFAULT (QUIRK_MEMORY_INCREMENT)
+#define QUIRKS_CHIP8 (QUIRK_MEMORY_INCREMENT | QUIRK_SHIFT_VY | QUIRK_VF_RESET)
+#define QUIRKS_SCHIP (QUIRK_JUMP_VX)
+#define QUIRKS_XOCHIP (QUIRK_MEMORY_INCREMENT | QUIRK_SHIFT_VY | QUIRK_WRAP)
+
+/*
+Interpreters.
+The switch engine decodes with nested switches compiled once per quirk profile, the table engine looks every opcode up in a table built from opcodes.h.
+*/
+enum {
+	CHIP8_ENGINE_SWITCH,
+	CHIP8_ENGINE_TABLE
+};
+
+/*
+Timing models.
+Fast runs 10 instructions a frame whatever they are.
+COSMAC counts approximate COSMAC VIP machine cycles for every opcode, draws cost more the more rows they draw and wait for the next frame, as the original interpreter waited for the vertical blank.
+*/
+enum {
+	CHIP8_TIMING_FAST,
+	CHIP8_TIMING_COSMAC
+};
+
+/*
+Machine cycles the COSMAC VIP left to the interpreter in a frame, after the display's DMA and interrupt.
+*/
+#define COSMAC_CYCLES_PER_FRAME 1832
+
+#define MEMORY_PAGE_SIZE 0x100
+#define MEMORY_PAGES (0x1000 / MEMORY_PAGE_SIZE)
+
+/*
+Type Declarations
+*/
+
+/*
+A page of memory.
+Pages are shared between machines, a machine copies a page the first time it stores to it while anything else references it.
+*/
+typedef struct {
+	int References;
+	unsigned char Bytes[MEMORY_PAGE_SIZE];
+} Page;
+
+typedef struct {
+	unsigned short ProgramCounter;
+	unsigned short Stack[32];
+	/*
+	Index of the last return address pushed, from -1 when the stack is empty to 31.
+	*/
+	int StackCounter;
+	Display DisplayBuffer;
+	int DisplayIsHigh;
+	/*
+	One bit per row of the display buffer stored to since the bit was last cleared.
+	Bit n covers Low[n], or High[0][n] and High[1][n].
+	*/
+	unsigned long long DirtyRows;
+	/*
+	Quirks in effect, the compatability opcode clears QUIRK_MEMORY_INCREMENT.
+	*/
+	int Quirks;
+	/*
+	Interpreter that runs the machine.
+	*/
+	int Engine;
+	unsigned char Time;
+	unsigned char Tone;
+	unsigned short I;
+	unsigned short Keys;
+	unsigned short KeyMask;
+	int WaitingForKeyPress;
+	unsigned char V[16];
+	/*
+	Read and write through readMemory and writeMemory.
+	Addresses wrap at 4 KB, so ProgramCounter and I may run past 0xFFF.
+	*/
+	Page *Memory[MEMORY_PAGES];
+	/*
+	Set when the program exits.
+	*/
+	int ExitValue;
+	/*
+	Ticks run in the current frame, kept by chip8RunUntil, chip8RunCycles and frontends running frames themselves.
+	Draws with the COSMAC timing model wait for the end of the frame from here.
+	A tick is an instruction, or a machine cycle with the COSMAC timing model.
+	*/
+	int FrameTick;
+	int TicksPerFrame;
+	int Timing;
+	/*
+	One bit per address.
+	*/
+	unsigned char Breakpoints[0x1000 / 8];
+	int AtBreakpoint;
+	/*
+	One bit per address watched for stores, and the registers watched for changes.
+	*/
+	unsigned char Watchpoints[0x1000 / 8];
+	int WatchRegisters;
+	/*
+	The watched address the last CHIP8_WATCH stop stored to, or -1 if it stopped on a register.
+	*/
+	int WatchHit;
+	/*
+	Counted since the program was loaded, for metrics.
+	Instructions are added up once per call to runUntil, draws and collisions as they happen.
+	*/
+	unsigned long long Instructions;
+	unsigned long long Draws;
+	unsigned long long Collisions;
+} State;
+
+/*
+Function Declarations
+*/
+
+/*
+Chip8 Declarations
+*/
+
+/*
+0x00E0
+clear
+Clears the screen.
+*/
+void
+clearScreen(State *state);
+
+/*
+0x00EE
+ret
+Returns from subroutine.
+*/
+void
+subroutineReturn(State *state);
+
+/*
+DEPRECATED
+0x00FA
+compatability
+Only for backwards compatability.
+Causes "save" and "restore" opcodes to leave I register unchanged by clearing QUIRK_MEMORY_INCREMENT.
+*/
+void
+compatability(State *state);
+
+/*
+0x0NNN
+jump addr
+Jumps to address NNN
+NNN must be even.
+NNN must be in range 0x200 to 0xFFE.
+*/
+void
+jump(State *state, unsigned short address);
+
+/*
+0xBNNN
+jump addr, v0
+Jumps to address NNN + v0
+NNN must be even.
+v0 must be even.
+NNN + v0 must be even.
+NNN + v0 must be in range 0x200 to 0xFFE.
+With QUIRK_JUMP_VX jumps to address NNN + vX instead, where X is the high nibble of NNN.
+*/
+void
+jumpv0(State *state, unsigned short address);
+
+/*
+0x1NNN
+call addr
+Calls subroutine at address NNN.
+NNN must be even.
+NNN must be in range 0x200 to 0xFFE.
+*/
+void
+call(State *state, unsigned short address);
+
+
+/*
+0x3XYY
+skip.eq vX, value
+Skips the next instruction if vX is equal to value.
+*/
+void
+skipEqvXValue(State *state, unsigned char registerX, unsigned char value);
+
+/*
+0x3XY0
+skip.eq vX, Vy
+Skips the next instruction if vX is equal to vY.
+*/
+void
+skipEqvXvY(State *state, unsigned char registerX, unsigned char registerY);
+
+/*
+0xEX9E
+skip.eq vX, key
+Skips the next instruction if the key with the value of the lower 4 bits of vX is being pressed.
+*/
+void
+skipvXKey(State *state, unsigned char registerX);
+
+/*
+0x4XKK
+skip.ne vX, value
+Skips the next instruction if vX is not equal to value.
+*/
+void
+skipNevXValue(State *state, unsigned char registerX, unsigned char value);
+
+/*
+0x9XY0
+skip.ne vY, vY
+Skips the next instruction if vY is not equal to vY.
+*/
+void
+skipNevXvY(State *state, unsigned char registerX, unsigned char registerY);
+
+/*
+0xEXA1
+skip.ne vX, key
+Skips the next instruction if the key with the value of the lower 4 bits of vX is not being pressed.
+*/
+void
+skipNevXKey(State *state, unsigned char registerX);
+
+/*
+0x6XKK
+load vX, value
+Loads register vX with value.
+*/
+void
+loadvXValue(State *state, unsigned char registerX, unsigned char value);
+
+/*
+0xFX0A
+load vX, key
+If no key is currently pressed wait until one is, then load vX with the lowest key currently being pressed.
+Loaded key will not be registered as pressed again until it is let go and re-pressed.
+*/
+void
+loadvXKey(State *state, unsigned char registerX);
+
+/*
+0x8XY0
+load vX, vY
+Loads register vX with value of vY.
+*/
+void
+loadvXvY(State *state, unsigned char registerX, unsigned char registerY);
+
+/*
+0xFX07
+load vX, time
+Loads register vX with the value of the time register.
+*/
+void
+loadvXTime(State *state, unsigned char registerX);
+
+/*
+0xFX15
+load time, vX
+Loads the time register with the value of register vX.
+*/
+void
+loadTimevX(State *state, unsigned char registerX);
+
+/*
+0xFX18
+load tone, vX
+Loads the tone register with the value of register vX.
+*/
+void
+loadTonevX(State *state, unsigned char registerX);
+
+/*
+0xANNN
+load i, addr
+Loads the I register with NNN.
+NNN must be in the range 0x200 to 0xFFF
+*/
+void
+loadI(State *state, unsigned short address);
+
+/*
+0x7XKK
+add vX, value
+Adds KK to register vX.
+*/
+void
+addvXValue(State *state, unsigned char registerX, unsigned char value);
+
+/*
+0x8XY4
+add vX, vY
+Adds register vY to register vX.
+Register v15 is set to 1 if result overflows.
+Else register v15 is set to 0.
+*/
+void
+addvXvY(State *state, unsigned char registerX, unsigned char registerY);
+
+/*
+0xFX1E
+add i, vX
+Adds the value of register vX to the I register.
+*/
+void
+addIvX(State *state, unsigned char registerX);
+
+/*
+0x8XY1
+or vX, vY
+Bitwise ORs the value of register vY into register vX.
+With QUIRK_VF_RESET register v15 is then set to 0.
+*/
+void
+orvXvY(State *state, unsigned char registerX, unsigned char registerY);
+
+/*
+0x8XY2
+and vX, vY
+Bitwise ANDs the value of register vY into register vX.
+With QUIRK_VF_RESET register v15 is then set to 0.
+*/
+void
+andvXvY(State *state, unsigned char registerX, unsigned char registerY);
+
+/*
+0x8XY3
+xor vX, vY
+Bitwise XORs the value of register vY into register vX.
+With QUIRK_VF_RESET register v15 is then set to 0.
+*/
+void
+xorvXvY(State *state, unsigned char registerX, unsigned char registerY);
+
+/*
+0x8XY5
+sub vX, vY
+Subtracts the value of register vY from register vX.
+Register v15 is set to 1 if the result underflows.
+Else register v15 is set to 0.
+*/
+void
+subvXvY(State *state, unsigned char registerX, unsigned char registerY);
+
+/*
+0x8XY6
+shr vX, vY
+Shifts the value of register vX right one bit.
+With QUIRK_SHIFT_VY register vX is set to the value of register vY shifted right one bit instead.
+Register v15 is set to 1 if the value shifted was odd.
+Else register v15 is set to 0.
+*/
+void
+shrvX(State *state, unsigned char registerX, unsigned char registerY);
+
+/*
+0x8XY7
+dif vX, vY
+Sets register vX to the value of register vY minus register vX.
+Register v15 is set to 1 if the result would be less than 0.
+Else register v15 is set to 0.
+*/
+void
+difvXvY(State *state, unsigned char registerX, unsigned char registerY);
+
+/*
+0x8XYE
+shl vX, vY
+Shifts the value of register vX left one bit.
+With QUIRK_SHIFT_VY register vX is set to the value of register vY shifted left one bit instead.
+Register v15 is set to 1 if the high bit of the value shifted was set.
+Else register v15 is set to 0.
+*/
+void
+shlvX(State *state, unsigned char registerX, unsigned char registerY);
+
+/*
+0xCXKK
+rnd vX, mask
+Sets register vX to the bitwise AND of a random number and KK.
+*/
+void
+rndvXMask(State *state, unsigned char registerX, unsigned char mask);
+
+/*
+0xDXYN
+draw xY, vY, rows
+Draws an image to the display buffer.
+The image is 8 pixels wide and N pixels long.
+The image is pointed to by the I register.
+The top left corner of the image will be at (register vX, register vY).
+Pixels are blitted to the display buffer using XOR.
+If this causes one or more pixels to be erased register v15 is set to 1.
+Else register v15 is set to 0.
+N must be in the range 1 to 15.
+The top left corner wraps around the display, the rest of the image is clipped at its edges or with QUIRK_WRAP wraps around them.
+*/
+void
+drawvXvYRows(State *state, unsigned char registerX, unsigned char registerY, unsigned char rows);
+
+/*
+0xFX29
+hex vX
+Points the I register to an image of a hex character representing the low 4 bits of register vX.
+The image is 4 pixels wide and 5 pixels long.
+*/
+void
+hexvX(State *state, unsigned char registerX);
+
+/*
+0xFX33
+bcd vX
+Stores a BCD(Binary Coded Decimal) representation of the value of register vX into memory starting at the byte pointed to by the I register. 
+Most significant digit is loaded first.
+*/
+void
+bcdvX(State *state, unsigned char registerX);
+
+/*
+0xFX55
+save vX
+Stores the values of registers v0 to vX in memory starting at the byte pointed to by the I register.
+With QUIRK_MEMORY_INCREMENT the I register is then advanced past the last byte stored.
+*/
+void
+savevX(State *state, unsigned char registerX);
+
+/*
+0xFX65
+restore vX
+Loads the values in memory starting at the byte pointed to by the I register into registers v0 to vX.
+With QUIRK_MEMORY_INCREMENT the I register is then advanced past the last byte loaded.
+*/
+void
+restorevX(State *state, unsigned char registerX);
+
+/*
+DEBUG OPCODE
+0x001X
+exit value
+Causes the program to exit with the value of X.
+X must be in the range 0 to 1.
+*/
+int
+programExitValue(State *state, unsigned char value);
+
+/*
+Super Chip8 Declarations
+*/
+
+/*
+0x00Cn
+scdown n
+Scrolls the display buffer down by n pixels.
+*/
+void
+scrollDownN(State *state, unsigned char n);
+
+/*
+0x00FB
+scright
+Scrolls the display buffer right 4 pixels.
+*/
+void
+scrollRight(State *state);
+
+/*
+0x00FC
+scleft
+Scrolls the display buffer left 4 pixels.
+*/
+void
+scrollLeft(State *state);
+
+/*
+0x00FE
+low
+Sets the display buffer to the low resolution (64 x 32).
+This is the default state.
+*/
+void
+displayBufferLow(State *state);
+
+/*
+0x00FF
+high
+Sets the display buffer to the high resolution (128 x 64).
+*/
+void
+displayBufferHigh(State *state);
+
+/*
+0xDXY0
+xdraw vX, vY
+Draws an image to the display buffer.
+The image is 16 pixels wide and 16 pixels long.
+The image is pointed to by the I register.
+The top left corner of the image will be at (register vX, register vY).
+Pixels are blitted to the display buffer using XOR.
+If this causes one or more pixels to be erased register v15 is set to 1.
+Else register v15 is set to 0.
+The image is clipped or wrapped like draw vX, vY, rows.
+*/
+void
+drawvXvY(State *state, unsigned char registerX, unsigned char registerY);
+
+/*
+0x00FD
+exit
+Causes the program to exit with a successful exit status.
+*/
+int
+programExit(State *state);
+
+/*
+Memory Declarations
+*/
+
+/*
+Returns a page of the machine's memory that nothing else references, copying it first if it is shared.
+Returns NULL if memory ran out.
+*/
+Page *
+writablePage(State *state, int page);
+
+/*
+Drops the machine's references to its memory.
+*/
+void
+releaseMemory(State *state);
+
+/*
+Releases into's memory and makes it share every page of from's.
+*/
+void
+shareMemory(State *into, const State *from);
+
+/*
+Addresses wrap around at 0x1000.
+*/
+static inline unsigned char
+readMemory(const State *state, unsigned short address)
+{
+	return state->Memory[address / MEMORY_PAGE_SIZE % MEMORY_PAGES]->Bytes[address % MEMORY_PAGE_SIZE];
+}
+
+/*
+The store is lost if the page had to be copied and memory ran out.
+*/
+static inline void
+writeMemory(State *state, unsigned short address, unsigned char value)
+{
+	Page *page = writablePage(state, address / MEMORY_PAGE_SIZE % MEMORY_PAGES);
+
+	if (page != NULL) {
+		page->Bytes[address % MEMORY_PAGE_SIZE] = value;
+	}
+}
+
+/*
+Interpreter Declarations
+*/
+
+/*
+Resets state and points its memory at the shared hex character images and zero pages.
+Memory state already holds is not released, call releaseMemory first when reusing a machine.
+*/
+void
+initMachineState(State *state);
+
+/*
+Runs up to ticks instructions in one loop.
+Every quirk profile has its own copy of the loop with its quirks compiled in, other combinations run a copy that reads them from state.
+Machines using the table engine run its loop instead, and machines with the COSMAC timing model a copy that counts cycles.
+With the COSMAC timing model ticks and executed count machine cycles, and the last instruction may run over ticks, which executed then includes.
+Draws then wait out the frame from FrameTick, so callers keep FrameTick at the tick of the frame they start on and advance it by executed.
+Breakpoints and watchpoints are only checked by a separate debugging copy, used when CHIP8_BREAKPOINT or CHIP8_WATCH is in the mask.
+Stops early right after an instruction that causes one of the events in the events mask, or before an instruction with a breakpoint when CHIP8_BREAKPOINT is in the mask.
+Always stops when the program exits.
+executed is set to the number of instructions run.
+Returns the event that stopped it, or CHIP8_CYCLES.
+*/
+int
+runUntil(State *state, int ticks, int events, int *executed);
+
+/*
+Runs up to ticks instructions.
+Stops early right after the tone register is loaded so the caller can time the tone edge.
+executed is set to the number of instructions run.
+Returns -1 while the program is running, else the program's exit value.
+*/
+int
+runTicks(State *state, int ticks, int *executed);
+
+/*
+Defined by a program translated with aot.
+Runs like runTicks but uses the precompiled program wherever it can.
+Counts the instructions it runs in Instructions, as runTicks does.
+*/
+int
+aotRun(State *state, int ticks, int *executed);
+
+/*
+Library Declarations
+*/
+
+/*
+Allocates a machine with the hex character images loaded.
+Returns NULL if memory ran out.
+*/
+State *
+chip8Create(void);
+
+void
+chip8Destroy(State *state);
+
+/*
+Returns a copy of the machine, or NULL if memory ran out.
+The copy shares every memory page with the original until one of them stores to it, so cloning costs about one copy of State without its memory.
+*/
+State *
+chip8Clone(const State *state);
+
+/*
+Makes into a copy of from like chip8Clone, reusing into so that machines can be kept in a pool.
+*/
+void
+chip8CloneInto(State *into, const State *from);
+
+/*
+Resets the machine and copies size bytes of program to 0x200.
+Memory pages the machine owns alone are cleared and reused, so loading program after program into one machine rarely allocates.
+Returns 0 on success, -1 if the program does not fit in memory.
+*/
+int
+chip8LoadRom(State *state, const unsigned char *program, size_t size);
+
+/*
+Runs cycles instructions, or fewer if the program exits.
+Returns -1 while the program is running, else the program's exit value.
+*/
+int
+chip8RunCycles(State *state, int cycles);
+
+/*
+Runs cycles instructions like chip8RunCycles, but stops at the first of the events in the events mask.
+Frames are TicksPerFrame instructions long and the time and tone registers count down at the end of each one, so hosts using this do not call chip8TickTimers.
+Returns the events that stopped the machine, more than one when they happen on the same instruction, or CHIP8_CYCLES if the cycles ran out first.
+CHIP8_EXIT is always returned when the program exits, ExitValue holds its exit value.
+*/
+int
+chip8RunUntil(State *state, int cycles, int events);
+
+/*
+Selects the quirks of the loaded program, a profile such as QUIRKS_SCHIP or any combination of QUIRK flags.
+Loading a program resets them to QUIRKS_DEFAULT.
+*/
+void
+chip8SetQuirks(State *state, int quirks);
+
+/*
+Selects the interpreter that runs the machine, CHIP8_ENGINE_SWITCH unless changed after loading a program.
+*/
+void
+chip8SetEngine(State *state, int engine);
+
+/*
+Selects the timing model, CHIP8_TIMING_FAST unless changed after loading a program.
+Sets TicksPerFrame to 10 instructions or COSMAC_CYCLES_PER_FRAME cycles.
+*/
+void
+chip8SetTiming(State *state, int timing);
+
+/*
+Returns the timing model called name: fast or cosmac.
+Returns -1 if there is no such model.
+*/
+int
+chip8FindTiming(const char *name);
+
+/*
+Returns the engine called name: switch or table.
+Returns -1 if there is no such engine.
+*/
+int
+chip8FindEngine(const char *name);
+
+/*
+Returns the profile called name: default, chip8, schip or xochip.
+Returns -1 if there is no such profile.
+*/
+int
+chip8FindQuirks(const char *name);
+
+/*
+Sets or clears a breakpoint.
+Breakpoints are cleared when a program is loaded.
+*/
+void
+chip8SetBreakpoint(State *state, unsigned short address, int enabled);
+
+/*
+Sets or clears watchpoints on length bytes of memory from address.
+chip8RunUntil stops with CHIP8_WATCH right after an instruction stores to one of them, with the first watched address stored to in WatchHit.
+Watchpoints are cleared when a program is loaded.
+*/
+void
+chip8SetWatchpoint(State *state, unsigned short address, unsigned short length, int enabled);
+
+/*
+Watches the registers in the registers mask, v0 to v15 in bits 0 to 15 and WATCH_I.
+chip8RunUntil stops with CHIP8_WATCH right after an instruction changes one of them.
+*/
+void
+chip8WatchRegisters(State *state, int registers);
+
+/*
+Counts the time and tone registers down by one.
+Call at 60 Hz.
+*/
+void
+chip8TickTimers(State *state);
+
+/*
+Loads the Keys register with a bitmask of the keys being pressed, key N at bit N.
+*/
+void
+chip8SetKeys(State *state, unsigned short keys);
+
+/*
+Returns the display buffer, which is valid for as long as the machine is.
+isHigh is set when the display is in the high resolution, it may be NULL.
+*/
+const Display *
+chip8Framebuffer(const State *state, int *isHigh);
+
+#endif
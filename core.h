@@ -0,0 +1,416 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+The interpreter loop, included by chip8.c once for every quirk profile.
+Define CORE_NAME as the name of the function to define and CORE_QUIRKS as its quirks before including it.
+CORE_QUIRKS is a constant for the profiles so every quirk check is decided at compile time.
+Define CORE_TIMED as 1, or an expression, for copies that count machine cycles instead of instructions.
+frameTick is the tick of the frame the loop starts on, which timed copies work the wait of draws out from.
+Define CORE_DEBUG as 1 for the copy that checks breakpoints and watchpoints.
+*/
+
+#ifndef CORE_TIMED
+#define CORE_TIMED 0
+#endif
+
+#ifndef CORE_DEBUG
+#define CORE_DEBUG 0
+#endif
+
+static int
+CORE_NAME(State *state, int frameTick, int ticks, int events, int *executed)
+{
+	int i;
+
+	for (i = 0; i < ticks; i++) {
+		int event = 0;
+		unsigned short opcode;
+		#if CORE_DEBUG
+		Watch watch;
+
+		/*
+		A breakpoint stops the machine before its instruction runs, and lets it through on the next call.
+		*/
+		if ((events & CHIP8_BREAKPOINT) && (state->Breakpoints[(state->ProgramCounter & 0xFFF) >> 3] & (1 << (state->ProgramCounter & 7)))) {
+			if (!state->AtBreakpoint) {
+				state->AtBreakpoint = 1;
+				*executed = i;
+				return CHIP8_BREAKPOINT;
+			}
+		}
+		state->AtBreakpoint = 0;
+		#endif
+
+		opcode = (readMemory(state, state->ProgramCounter) << 8) | readMemory(state, state->ProgramCounter + 1);		
+		if (CORE_TIMED) {
+			/*
+			The cycles are counted up front, so returning with i + 1 below gives the cycles run.
+			*/
+			i += opcodeCycles(opcode, frameTick + i, state->TicksPerFrame) - 1;
+			state->Instructions++;
+		}
+		#if CORE_DEBUG
+		watchBefore(state, opcode, &watch);
+		#endif
+		#ifdef DEBUG
+		printf("Opcode: %X\n", opcode);
+		for (int j = 0; j < 15; j++) {
+			printf("v%i: %X\n", j, state->V[j]);
+		}	
+		printf("Keys: %X\n", state->Keys);
+		printf("DisplayBuffer:\n");
+		if (state->DisplayIsHigh) {
+			for (int i = 0; i < 64; i++) {
+				printf("%llX %llX\n", state->DisplayBuffer.High[0][i], state->DisplayBuffer.High[1][i]);
+			}
+		} else {
+			for (int i = 0; i < 32; i++) {
+				printf("%llX\n", state->DisplayBuffer.Low[i]);
+			}
+		}
+		getchar();
+		getchar();
+		#endif
+		/*
+		Match opcode to function
+		This could be made faster with a prefix tree
+		*/
+		switch (opcode & 0xF000) {
+		case 0x0000:
+			switch (opcode & 0xF00) {
+			case 0x000:
+				switch (opcode & 0xF0) {
+				case 0x10:
+					/*
+					0x001X
+					*/
+					state->ExitValue = programExitValue(state, opcode & 0xF);
+					*executed = i + 1;
+					return CHIP8_EXIT;
+				case 0xC0:
+					/*
+					0x00C0
+					*/
+					scrollDownN(state, opcode & 0xF);
+					break;
+				case 0xE0:
+					switch (opcode & 0xF) {
+					case 0x0:
+						/*
+						0x00E0
+						*/
+						clearScreen(state);
+						break;
+					case 0xE:
+						/*
+						0x00EE
+						*/
+						subroutineReturn(state);
+						break;
+					}
+					break;
+				case 0xF0:
+					switch (opcode & 0xF) {
+					case 0xA:
+						/*
+						0x00FA
+						*/
+						compatability(state);
+						if (state->Quirks != (CORE_QUIRKS)) {
+							event = CORE_QUIRKS_CHANGED;
+						}
+						break;
+					case 0xB:
+						/*
+						0x00FB
+						*/
+						scrollRight(state);
+						break;
+					case 0xC:
+						/*
+						0x00FC
+						*/
+						scrollLeft(state);
+						break;
+					case 0xD:
+						/*
+						0x00FD
+						*/
+						state->ExitValue = programExit(state);
+						*executed = i + 1;
+						return CHIP8_EXIT;
+					case 0xE:
+						/*
+						0x00FE
+						*/
+						displayBufferLow(state);
+						break;
+					case 0xF:
+						/*
+						0x00FF
+						*/
+						displayBufferHigh(state);
+						break;
+					}
+					break;
+				}
+				break;
+			default:
+				jump(state, opcode & 0xFFF);	
+				break;
+			}
+			break;
+		case 0x1000:
+			/*
+			0x1NNN
+			*/
+			call(state, opcode & 0xFFF);
+			break;
+		case 0x3000:
+			switch (opcode & 0xF) {
+			case 0x0:
+				/*
+				0x3XY0
+				*/
+				skipEqvXvY(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+				break;
+			default:
+				/*
+				0x3XYY
+				*/
+				skipEqvXValue(state, (opcode & 0xF00) >> 8, opcode & 0xFF);
+				break;
+			}
+			break;
+		case 0x4000:
+			/*
+			0x4XKK
+			*/
+			skipNevXValue(state, (opcode & 0xF00) >> 8, opcode & 0xFF);
+			break;
+		case 0x6000:
+			/*
+			0x6XKK
+			*/
+			loadvXValue(state, (opcode & 0xF00) >> 8, opcode & 0xFF);
+			break;
+		case 0x7000:
+			/*
+			0x7XKK
+			*/
+			addvXValue(state, (opcode & 0xF00) >> 8, opcode & 0xFF);
+			break;
+		case 0x8000:
+			switch (opcode & 0xF) {
+			case 0x0:
+				/*
+				0x8XY0
+				*/
+				loadvXvY(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+				break;
+			case 0x1:
+				/*
+				0x8XY1
+				*/
+				orvXvYQuirks(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, CORE_QUIRKS);
+				break;
+			case 0x2:
+				/*
+				0x8XY2
+				*/
+				andvXvYQuirks(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, CORE_QUIRKS);
+				break;
+			case 0x3:
+				/*
+				0x8XY3
+				*/
+				xorvXvYQuirks(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, CORE_QUIRKS);
+				break;
+			case 0x4:
+				/*
+				0x8XY4
+				*/
+				addvXvY(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+				break;
+			case 0x5:
+				/*
+				0x8XY5
+				*/
+				subvXvY(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+				break;
+			case 0x6:
+				/*
+				0x8XY6
+				*/
+				shrvXQuirks(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, CORE_QUIRKS);
+				break;
+			case 0x7:
+				/*
+				0x8XY7
+				*/
+				difvXvY(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+				break;
+			case 0xE:
+				/*
+				0x8XYE
+				*/
+				shlvXQuirks(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, CORE_QUIRKS);
+				break;
+			}
+			break;
+		case 0x9000:
+			/*
+			0x9XY0
+			*/
+			skipNevXvY(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+			break;
+		case 0xA000:
+			/*
+			0xANNN
+			*/
+			loadI(state, opcode & 0xFFF);
+			break;
+		case 0xB000:
+			/*
+			0xBNNN
+			*/
+			jumpv0Quirks(state, opcode & 0xFFF, CORE_QUIRKS);
+			break;
+		case 0xC000:
+			/*
+			0xCXKK
+			*/
+			rndvXMask(state, (opcode & 0xF00) >> 8, opcode & 0xFF);
+			break;
+		case 0xD000:
+			switch (opcode & 0xF) {
+
+			case 0x0:
+				/*
+				0xDXY0
+				*/
+				#ifdef DEBUG
+				printf("draw %X, %X\n", (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
+				#endif
+
+				drawSprite(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, 16, 1, CORE_QUIRKS);
+				event = CHIP8_DRAW;
+				break;
+			default:
+				/*
+				0xDXYN
+				*/
+				drawSprite(state, (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, opcode & 0xF, 0, CORE_QUIRKS);
+				event = CHIP8_DRAW;
+				break;
+			}
+		case 0xE000:
+			switch (opcode & 0xFF) {
+			case 0x9E:
+				/*
+				0xEX9E
+				*/
+				skipvXKey(state, (opcode & 0xF00) >> 8);
+				break;
+			case 0xA1:
+				/*
+				0xEXA1
+				*/
+				skipNevXKey(state, (opcode & 0xF00) >> 8);
+				break;
+			}
+			break;
+		case 0xF000:
+			switch (opcode & 0xFF) {
+			case 0x07:
+				/*
+				0xFX07
+				*/
+				loadvXTime(state, (opcode & 0xF00) >> 8);
+				break;
+			case 0x0A:
+				/*
+				0xFX0A
+				*/
+				loadvXKey(state, (opcode & 0xF00) >> 8);
+				if (state->WaitingForKeyPress) {
+					event = CHIP8_KEY_WAIT;
+				}
+				break;
+			case 0x15:
+				/*
+				0xFX15
+				*/
+				loadTimevX(state, (opcode & 0xF00) >> 8);
+				break;
+			case 0x18:
+				/*
+				0xFX18
+				*/
+				loadTonevX(state, (opcode & 0xF00) >> 8);
+				event = CHIP8_TONE;
+				break;
+			case 0x1E:
+				/*
+				0xFX1E
+				*/
+				addIvX(state, (opcode & 0xF00) >> 8);
+				break;
+			case 0x29:
+				/*
+				0xFX29
+				*/
+				hexvX(state, (opcode & 0xF00) >> 8);
+				break;
+			case 0x33:
+				/*
+				0xFX33
+				*/
+				bcdvX(state, (opcode & 0xF00) >> 8);
+				break;
+			case 0x55:
+				/*
+				0xFX55
+				*/
+				savevXQuirks(state, (opcode & 0xF00) >> 8, CORE_QUIRKS);
+				break;
+			case 0x65:
+				/*
+				0xFX65
+				*/
+				restorevXQuirks(state, (opcode & 0xF00) >> 8, CORE_QUIRKS);
+				break;
+			}
+			break;
+		}
+		
+		if (!state->WaitingForKeyPress) {
+			state->ProgramCounter += 2;
+		}
+
+		#if CORE_DEBUG
+		if ((events & CHIP8_WATCH) && watchAfter(state, &watch)) {
+			event |= CHIP8_WATCH;
+		}
+		#endif
+
+		if (event & (events | CORE_QUIRKS_CHANGED)) {
+			*executed = i + 1;
+			return event;
+		}
+	}
+
+	/*
+	With a timing model the last instruction may have run past ticks, and the cycles it ran over are counted too.
+	*/
+	*executed = i;
+
+	return CHIP8_CYCLES;
+}
+
+#undef CORE_NAME
+#undef CORE_QUIRKS
+#undef CORE_TIMED
+#undef CORE_DEBUG
@@ -0,0 +1,389 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Interactive debugger.
+Reads commands from standard input, type h for a list.
+The machine only runs the debugging copy of the interpreter loop while breakpoints or watchpoints are set, else it runs at full speed.
+Interrupt a running machine with ^C.
+*/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "disasm.h"
+#include "rom.h"
+
+/*
+Function Declarations
+*/
+
+void
+interrupt(int signal);
+
+int
+parseWatch(const char *text, int *registers, unsigned short *address, unsigned short *length);
+
+void
+printRegisters(const State *state);
+
+void
+printDisassembly(const State *state, unsigned short address, int count);
+
+void
+printMemory(const State *state, unsigned short address, int length);
+
+void
+printDisplay(State *state);
+
+void
+printEvent(const State *state, int event);
+
+int
+runFrames(State *state, int events);
+
+/*
+Global Variables
+*/
+
+volatile sig_atomic_t Interrupted = 0;
+
+/*
+Breakpoints set, so continuing can skip the debugging loop when there are none.
+*/
+int BreakpointCount = 0;
+
+/*
+Function Definitions
+*/
+
+void
+interrupt(int signal)
+{
+	(void)signal;
+	Interrupted = 1;
+}
+
+/*
+Parses v0 to vf, i, or an address or address-end range.
+Sets registers to the register bit, or address and length.
+Returns 0 on success, -1 if text is none of them.
+*/
+int
+parseWatch(const char *text, int *registers, unsigned short *address, unsigned short *length)
+{
+	unsigned int start;
+	unsigned int end;
+	char *rest;
+
+	*registers = 0;
+
+	if ((text[0] == 'v' || text[0] == 'V') && text[1] != '\0' && text[2] == '\0') {
+		start = strtoul(text + 1, &rest, 16);
+		if (*rest != '\0') {
+			return -1;
+		}
+		*registers = 1 << start;
+		return 0;
+	}
+
+	if (strcmp(text, "i") == 0 || strcmp(text, "I") == 0) {
+		*registers = WATCH_I;
+		return 0;
+	}
+
+	start = strtoul(text, &rest, 16);
+	if (rest == text) {
+		return -1;
+	}
+	end = start;
+	if (*rest == '-') {
+		end = strtoul(rest + 1, &rest, 16);
+	}
+	if (*rest != '\0' || end < start || end > 0xFFF) {
+		return -1;
+	}
+
+	*address = start;
+	*length = end - start + 1;
+	return 0;
+}
+
+void
+printRegisters(const State *state)
+{
+	for (int i = 0; i < 16; i++) {
+		printf("v%x %02x%s", i, state->V[i], i % 8 == 7 ? "\n" : "  ");
+	}
+	printf("i %03x  pc %03x  sp %d  time %02x  tone %02x  keys %04x%s\n",
+		state->I, state->ProgramCounter, state->StackCounter, state->Time, state->Tone, state->Keys,
+		state->WaitingForKeyPress ? "  waiting for key" : "");
+}
+
+void
+printDisassembly(const State *state, unsigned short address, int count)
+{
+	for (int i = 0; i < count; i++) {
+		unsigned short at = (address + i * 2) & 0xFFF;
+		unsigned short opcode = (readMemory(state, at) << 8) | readMemory(state, at + 1);
+		char text[32];
+
+		disassemble(opcode, text, sizeof(text));
+		printf("%c%c %03x  %04x  %s\n",
+			at == state->ProgramCounter ? '>' : ' ',
+			state->Breakpoints[at >> 3] & (1 << (at & 7)) ? '*' : ' ',
+			at, opcode, text);
+	}
+}
+
+void
+printMemory(const State *state, unsigned short address, int length)
+{
+	for (int i = 0; i < length; i++) {
+		if (i % 16 == 0) {
+			printf("%s%03x ", i ? "\n" : "", (address + i) & 0xFFF);
+		}
+		printf(" %02x", readMemory(state, (address + i) & 0xFFF));
+	}
+	printf("\n");
+}
+
+void
+printDisplay(State *state)
+{
+	int isHigh;
+	const Display *display = chip8Framebuffer(state, &isHigh);
+
+	if (isHigh) {
+		for (int y = 0; y < 64; y++) {
+			for (int x = 0; x < 128; x++) {
+				putchar(display->High[x >> 6][y] >> (63 - (x & 63)) & 1 ? '#' : '.');
+			}
+			putchar('\n');
+		}
+	} else {
+		for (int y = 0; y < 32; y++) {
+			for (int x = 0; x < 64; x++) {
+				putchar(display->Low[y] >> (63 - x) & 1 ? '#' : '.');
+			}
+			putchar('\n');
+		}
+	}
+}
+
+void
+printEvent(const State *state, int event)
+{
+	if (event & CHIP8_EXIT) {
+		printf("Exited with %d\n", state->ExitValue);
+	} else if (event & CHIP8_BREAKPOINT) {
+		printf("Breakpoint at %03x\n", state->ProgramCounter);
+	} else if (event & CHIP8_WATCH) {
+		printf("Watchpoint hit, stopped at %03x\n", state->ProgramCounter);
+	} else if (Interrupted) {
+		printf("Interrupted at %03x\n", state->ProgramCounter);
+	}
+}
+
+/*
+Runs a frame at a time until an event in events or an interrupt.
+Returns the event.
+*/
+int
+runFrames(State *state, int events)
+{
+	int event = CHIP8_CYCLES;
+
+	Interrupted = 0;
+	while (!Interrupted) {
+		event = chip8RunUntil(state, state->TicksPerFrame, events | CHIP8_FRAME) & ~CHIP8_FRAME;
+		if (event != CHIP8_CYCLES) {
+			break;
+		}
+	}
+
+	return event;
+}
+
+int
+main(int argc, char *argv[])
+{
+	char line[256];
+	int quirks = QUIRKS_DEFAULT;
+	int status;
+	State *machine;
+	Rom rom;
+
+	if (argc == 3) {
+		quirks = chip8FindQuirks(argv[2]);
+		if (quirks == -1) {
+			printf("Unknown quirk profile %s\n", argv[2]);
+			return 1;
+		}
+	} else if (argc != 2) {
+		printf("usage: %s program [profile]\n", argv[0]);
+		return 1;
+	}
+
+	status = romOpen(&rom, argv[1]);
+	if (status != ROM_OK) {
+		printf("%s: %s\n", argv[1], romError(&rom, status));
+		return 1;
+	}
+
+	machine = chip8Create();
+	if (machine == NULL) {
+		printf("Out of memory\n");
+		return 1;
+	}
+	chip8LoadRom(machine, rom.Data, rom.Size);
+	chip8SetQuirks(machine, quirks);
+
+	signal(SIGINT, interrupt);
+
+	printDisassembly(machine, machine->ProgramCounter, 1);
+	printf("> ");
+	fflush(stdout);
+	while (fgets(line, sizeof(line), stdin) != NULL) {
+		char command[16] = "";
+		char first[32] = "";
+		char second[32] = "";
+		int words = sscanf(line, "%15s %31s %31s", command, first, second);
+		int events = CHIP8_WATCH;
+		int watching = 0;
+
+		if (BreakpointCount > 0) {
+			events |= CHIP8_BREAKPOINT;
+		}
+		for (int i = 0; i < (int)sizeof(machine->Watchpoints); i++) {
+			watching |= machine->Watchpoints[i];
+		}
+		if (!watching && !machine->WatchRegisters) {
+			events &= ~CHIP8_WATCH;
+		}
+
+		if (words <= 0) {
+			/*
+			An empty line steps once more.
+			*/
+			strcpy(command, "s");
+		}
+
+		if (strcmp(command, "s") == 0) {
+			int count = words >= 2 ? atoi(first) : 1;
+			int event = CHIP8_CYCLES;
+
+			for (int i = 0; i < count && event == CHIP8_CYCLES; i++) {
+				event = chip8RunUntil(machine, 1, CHIP8_WATCH) & ~CHIP8_FRAME;
+			}
+			printEvent(machine, event);
+			printDisassembly(machine, machine->ProgramCounter, 1);
+		} else if (strcmp(command, "n") == 0) {
+			unsigned short pc = machine->ProgramCounter;
+			unsigned short opcode = (readMemory(machine, pc) << 8) | readMemory(machine, pc + 1);
+			int event;
+
+			if ((opcode & 0xF000) == 0x1000) {
+				/*
+				Runs the call to where it returns at the same depth, with a breakpoint there for the time.
+				*/
+				unsigned short next = (pc + 2) & 0xFFF;
+				int depth = machine->StackCounter;
+				int wasSet = machine->Breakpoints[next >> 3] & (1 << (next & 7));
+
+				chip8SetBreakpoint(machine, next, 1);
+				Interrupted = 0;
+				event = chip8RunUntil(machine, 1, CHIP8_WATCH) & ~CHIP8_FRAME;
+				while (event == CHIP8_CYCLES && !Interrupted) {
+					event = runFrames(machine, events | CHIP8_BREAKPOINT);
+					if (event == CHIP8_BREAKPOINT && machine->ProgramCounter == next && !wasSet) {
+						/*
+						Deeper down the same place is reached again by recursion, which runs on.
+						*/
+						event = CHIP8_CYCLES;
+						if (machine->StackCounter == depth) {
+							break;
+						}
+					}
+				}
+				if (!wasSet) {
+					chip8SetBreakpoint(machine, next, 0);
+					machine->AtBreakpoint = 0;
+				}
+			} else {
+				event = chip8RunUntil(machine, 1, CHIP8_WATCH) & ~CHIP8_FRAME;
+			}
+			printEvent(machine, event);
+			printDisassembly(machine, machine->ProgramCounter, 1);
+		} else if (strcmp(command, "c") == 0) {
+			printEvent(machine, runFrames(machine, events));
+			printDisassembly(machine, machine->ProgramCounter, 1);
+		} else if (strcmp(command, "b") == 0 || strcmp(command, "db") == 0) {
+			int enabled = command[0] == 'b';
+			unsigned short address;
+
+			if (words < 2) {
+				printf("usage: %s address\n", command);
+			} else {
+				address = strtoul(first, NULL, 16) & 0xFFF;
+				if (((machine->Breakpoints[address >> 3] >> (address & 7)) & 1) != enabled) {
+					BreakpointCount += enabled ? 1 : -1;
+				}
+				chip8SetBreakpoint(machine, address, enabled);
+			}
+		} else if (strcmp(command, "w") == 0 || strcmp(command, "dw") == 0) {
+			int enabled = command[0] == 'w';
+			int registers;
+			unsigned short address;
+			unsigned short length;
+
+			if (words < 2 || parseWatch(first, &registers, &address, &length) != 0) {
+				printf("usage: %s v0-vf | i | address[-end]\n", command);
+			} else if (registers) {
+				chip8WatchRegisters(machine, enabled ? machine->WatchRegisters | registers : machine->WatchRegisters & ~registers);
+			} else {
+				chip8SetWatchpoint(machine, address, length, enabled);
+			}
+		} else if (strcmp(command, "r") == 0) {
+			printRegisters(machine);
+		} else if (strcmp(command, "x") == 0) {
+			if (words < 2) {
+				printf("usage: x address [length]\n");
+			} else {
+				printMemory(machine, strtoul(first, NULL, 16) & 0xFFF, words >= 3 ? atoi(second) : 16);
+			}
+		} else if (strcmp(command, "l") == 0) {
+			printDisassembly(machine, words >= 2 ? strtoul(first, NULL, 16) & 0xFFF : machine->ProgramCounter, words >= 3 ? atoi(second) : 10);
+		} else if (strcmp(command, "k") == 0) {
+			chip8SetKeys(machine, words >= 2 ? strtoul(first, NULL, 16) : 0);
+		} else if (strcmp(command, "p") == 0) {
+			printDisplay(machine);
+		} else if (strcmp(command, "q") == 0) {
+			break;
+		} else {
+			printf("s [count]               step\n");
+			printf("n                       step over calls\n");
+			printf("c                       continue\n");
+			printf("b address, db address   set or delete a breakpoint\n");
+			printf("w what, dw what         watch v0-vf, i or address[-end] for changes, or stop\n");
+			printf("r                       show registers\n");
+			printf("x address [length]      show memory\n");
+			printf("l [address] [count]     disassemble\n");
+			printf("k keys                  hold keys, a hex mask\n");
+			printf("p                       show the display\n");
+			printf("q                       quit\n");
+		}
+
+		printf("> ");
+		fflush(stdout);
+	}
+
+	chip8Destroy(machine);
+	romClose(&rom);
+
+	return 0;
+}
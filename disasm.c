@@ -0,0 +1,298 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "disasm.h"
+
+/*
+Function Declarations
+*/
+
+static unsigned short
+operandBits(const OpcodeInfo *info);
+
+static const char *
+skipSpace(const char *text);
+
+static int
+parseNumber(const char **text, const Label *labels, int count, unsigned long *value);
+
+static int
+parseOperand(const char **text, int kind, const Label *labels, int count, unsigned short *opcode);
+
+/*
+Global Variables
+*/
+
+/*
+In the order the interpreter decodes them, the first match wins.
+*/
+#define OPCODE_INFO(mask, match, handler, mnemonic, first, second, third) { mask, match, mnemonic, { first, second, third } },
+
+static const OpcodeInfo Opcodes[] = {
+	OPCODES(OPCODE_INFO)
+};
+
+/*
+Function Definitions
+*/
+
+const OpcodeInfo *
+findOpcode(unsigned short opcode)
+{
+	for (size_t i = 0; i < sizeof(Opcodes) / sizeof(Opcodes[0]); i++) {
+		if ((opcode & Opcodes[i].Mask) == Opcodes[i].Match) {
+			return Opcodes[i].Mnemonic != NULL ? &Opcodes[i] : NULL;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+Returns the bits of an opcode that the operands of info are read from.
+*/
+static unsigned short
+operandBits(const OpcodeInfo *info)
+{
+	unsigned short bits = 0;
+
+	for (int i = 0; i < OPCODE_OPERANDS; i++) {
+		switch (info->Operands[i]) {
+		case OPERAND_VX:
+			bits |= 0xF00;
+			break;
+		case OPERAND_VY:
+			bits |= 0xF0;
+			break;
+		case OPERAND_BYTE:
+			bits |= 0xFF;
+			break;
+		case OPERAND_ADDRESS:
+			bits |= 0xFFF;
+			break;
+		case OPERAND_NIBBLE:
+			bits |= 0xF;
+			break;
+		}
+	}
+
+	return bits;
+}
+
+int
+disassemble(unsigned short opcode, char *text, size_t size)
+{
+	const OpcodeInfo *info = findOpcode(opcode);
+	int length;
+
+	/*
+	Bits that neither the mask nor an operand covers would be lost in the text, so those opcodes are data too.
+	*/
+	if (info == NULL || (opcode & ~(info->Mask | operandBits(info))) != 0) {
+		return snprintf(text, size, "data 0x%04X", opcode);
+	}
+
+	length = snprintf(text, size, "%s", info->Mnemonic);
+
+	for (int i = 0; i < OPCODE_OPERANDS && info->Operands[i] != OPERAND_NONE; i++) {
+		const char *separator = i == 0 ? " " : ", ";
+		size_t used = (size_t)length < size ? (size_t)length : size;
+
+		switch (info->Operands[i]) {
+		case OPERAND_VX:
+			length += snprintf(text + used, size - used, "%sv%d", separator, (opcode & 0xF00) >> 8);
+			break;
+		case OPERAND_VY:
+			length += snprintf(text + used, size - used, "%sv%d", separator, (opcode & 0xF0) >> 4);
+			break;
+		case OPERAND_BYTE:
+			length += snprintf(text + used, size - used, "%s0x%02X", separator, opcode & 0xFF);
+			break;
+		case OPERAND_ADDRESS:
+			length += snprintf(text + used, size - used, "%s0x%03X", separator, opcode & 0xFFF);
+			break;
+		case OPERAND_NIBBLE:
+			length += snprintf(text + used, size - used, "%s%d", separator, opcode & 0xF);
+			break;
+		case OPERAND_V0:
+			length += snprintf(text + used, size - used, "%sv0", separator);
+			break;
+		case OPERAND_I:
+			length += snprintf(text + used, size - used, "%si", separator);
+			break;
+		case OPERAND_KEY:
+			length += snprintf(text + used, size - used, "%skey", separator);
+			break;
+		case OPERAND_TIME:
+			length += snprintf(text + used, size - used, "%stime", separator);
+			break;
+		case OPERAND_TONE:
+			length += snprintf(text + used, size - used, "%stone", separator);
+			break;
+		}
+	}
+
+	return length;
+}
+
+static const char *
+skipSpace(const char *text)
+{
+	while (isspace((unsigned char)*text)) {
+		++text;
+	}
+
+	return text;
+}
+
+/*
+Reads a decimal number, a hex number starting with 0x, or a label, and moves text past it.
+Returns 0 on success, -1 if there is none.
+*/
+static int
+parseNumber(const char **text, const Label *labels, int count, unsigned long *value)
+{
+	const char *start = *text;
+	char *end;
+	size_t length = 0;
+
+	if (isdigit((unsigned char)*start)) {
+		*value = strtoul(start, &end, start[0] == '0' && (start[1] == 'x' || start[1] == 'X') ? 16 : 10);
+		*text = end;
+		return 0;
+	}
+
+	while (isalnum((unsigned char)start[length]) || start[length] == '_' || start[length] == '.') {
+		++length;
+	}
+
+	for (int i = 0; i < count && length > 0; i++) {
+		if (strlen(labels[i].Name) == length && strncmp(labels[i].Name, start, length) == 0) {
+			*value = labels[i].Address;
+			*text = start + length;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/*
+Reads an operand of kind into its field of opcode and moves text past it.
+Returns 0 on success, -1 if the operand is not of that kind or out of range.
+*/
+static int
+parseOperand(const char **text, int kind, const Label *labels, int count, unsigned short *opcode)
+{
+	static const char *const Words[] = {
+		[OPERAND_V0] = "v0", [OPERAND_I] = "i", [OPERAND_KEY] = "key", [OPERAND_TIME] = "time", [OPERAND_TONE] = "tone"
+	};
+	const char *start = skipSpace(*text);
+	unsigned long value;
+	char *end;
+
+	switch (kind) {
+	case OPERAND_VX:
+	case OPERAND_VY:
+		if (*start != 'v' && *start != 'V') {
+			return -1;
+		}
+		if (isdigit((unsigned char)start[1])) {
+			value = strtoul(start + 1, &end, 10);
+		} else if (isxdigit((unsigned char)start[1])) {
+			value = strtoul(start + 1, &end, 16);
+		} else {
+			return -1;
+		}
+		if (value > 0xF || isalnum((unsigned char)*end)) {
+			return -1;
+		}
+		*opcode |= kind == OPERAND_VX ? value << 8 : value << 4;
+		*text = end;
+		return 0;
+	case OPERAND_BYTE:
+	case OPERAND_ADDRESS:
+	case OPERAND_NIBBLE:
+		if (parseNumber(&start, labels, count, &value) != 0) {
+			return -1;
+		}
+		if (value > (kind == OPERAND_BYTE ? 0xFF : kind == OPERAND_ADDRESS ? 0xFFF : 0xF)) {
+			return -1;
+		}
+		*opcode |= value;
+		*text = start;
+		return 0;
+	default: {
+		size_t length = strlen(Words[kind]);
+
+		if (strncmp(start, Words[kind], length) != 0 || isalnum((unsigned char)start[length])) {
+			return -1;
+		}
+		*text = start + length;
+		return 0;
+	}
+	}
+}
+
+int
+assemble(const char *text, const Label *labels, int count, unsigned short *opcode)
+{
+	const char *operands;
+	size_t length = 0;
+
+	text = skipSpace(text);
+	while (text[length] != '\0' && !isspace((unsigned char)text[length])) {
+		++length;
+	}
+	operands = text + length;
+
+	if (length == 4 && strncmp(text, "data", 4) == 0) {
+		unsigned long value;
+
+		operands = skipSpace(operands);
+		if (parseNumber(&operands, labels, count, &value) != 0 || value > 0xFFFF || *skipSpace(operands) != '\0') {
+			return -1;
+		}
+		*opcode = value;
+		return 0;
+	}
+
+	/*
+	Tries every description with the mnemonic, and keeps the first the operands fit that also decodes back to it.
+	Operands are written into fields cleared of the match, so they cannot leave bits of it behind.
+	*/
+	for (size_t i = 0; i < sizeof(Opcodes) / sizeof(Opcodes[0]); i++) {
+		const OpcodeInfo *info = &Opcodes[i];
+		const char *next = operands;
+		unsigned short encoded = info->Match & ~operandBits(info);
+		int fits = 1;
+
+		if (info->Mnemonic == NULL || strlen(info->Mnemonic) != length || strncmp(info->Mnemonic, text, length) != 0) {
+			continue;
+		}
+
+		for (int j = 0; j < OPCODE_OPERANDS && info->Operands[j] != OPERAND_NONE && fits; j++) {
+			if (j > 0) {
+				next = skipSpace(next);
+				if (*next++ != ',') {
+					fits = 0;
+					break;
+				}
+			}
+			fits = parseOperand(&next, info->Operands[j], labels, count, &encoded) == 0;
+		}
+
+		if (fits && *skipSpace(next) == '\0' && (encoded & info->Mask) == info->Match && findOpcode(encoded) == info) {
+			*opcode = encoded;
+			return 0;
+		}
+	}
+
+	return -1;
+}
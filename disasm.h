@@ -0,0 +1,66 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Disassembler and assembler using the mnemonics documented in chip8.h, both driven by the opcode descriptions in opcodes.h.
+*/
+
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <stddef.h>
+
+#include "opcodes.h"
+
+/*
+Type Declarations
+*/
+
+/*
+An opcode matches when (opcode & Mask) == Match.
+A NULL Mnemonic marks opcodes the interpreter does nothing for, which are shown as data.
+*/
+typedef struct {
+	unsigned short Mask;
+	unsigned short Match;
+	const char *Mnemonic;
+	unsigned char Operands[OPCODE_OPERANDS];
+} OpcodeInfo;
+
+/*
+A name for an address in assembly text.
+*/
+typedef struct {
+	char Name[32];
+	unsigned short Address;
+} Label;
+
+/*
+Function Declarations
+*/
+
+/*
+Returns the description of opcode, or NULL if it has none.
+*/
+const OpcodeInfo *
+findOpcode(unsigned short opcode);
+
+/*
+Writes opcode as text into text, such as "skip.eq v3, 0x12".
+Opcodes without a description, or with bits the description does not read, are written as "data 0x1234".
+Returns the length of the text, which is truncated to size.
+*/
+int
+disassemble(unsigned short opcode, char *text, size_t size);
+
+/*
+Reads one instruction as written by disassemble, such as "skip.eq v3, 0x12", into opcode.
+Numbers are decimal or hex with 0x, registers are v0 to v15 or v0 to vf, and addresses may be any of count labels.
+"data" takes any 16 bit number.
+Returns 0 on success, -1 if text is not an instruction or its operands cannot be encoded.
+*/
+int
+assemble(const char *text, const Label *labels, int count, unsigned short *opcode);
+
+#endif
@@ -0,0 +1,97 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include <string.h>
+
+#include "display.h"
+
+/*
+Function Definitions
+*/
+
+void
+frameTripleInit(FrameTriple *triple)
+{
+	memset(triple, 0, sizeof(*triple));
+
+	triple->Back = 0;
+	triple->Middle = 1;
+	triple->Front = 2;
+}
+
+Frame *
+frameTripleBack(FrameTriple *triple)
+{
+	return &triple->Slots[triple->Back];
+}
+
+Frame *
+frameTriplePublish(FrameTriple *triple)
+{
+	/*
+	Swap the back slot into the middle, releasing the frame written to it.
+	*/
+	triple->Back = __atomic_exchange_n(&triple->Middle, triple->Back | FRAME_FRESH, __ATOMIC_ACQ_REL) & 3;
+
+	return &triple->Slots[triple->Back];
+}
+
+const Frame *
+frameTripleFront(FrameTriple *triple)
+{
+	/*
+	Only swap when the middle slot holds a new frame, otherwise keep showing the current one.
+	*/
+	if (__atomic_load_n(&triple->Middle, __ATOMIC_RELAXED) & FRAME_FRESH) {
+		triple->Front = __atomic_exchange_n(&triple->Middle, triple->Front, __ATOMIC_ACQ_REL) & 3;
+	}
+
+	return &triple->Slots[triple->Front];
+}
+
+int
+persistenceInit(Persistence *persistence, int frames)
+{
+	if (frames < 1 || frames > PERSISTENCE_MAX) {
+		return -1;
+	}
+
+	memset(persistence, 0, sizeof(*persistence));
+	persistence->Frames = frames;
+
+	return 0;
+}
+
+const Display *
+persistenceApply(Persistence *persistence, const Display *display, int isHigh)
+{
+	/*
+	Both resolutions are whole words laid out one after another, so the blend runs over a flat array.
+	*/
+	int words = (isHigh ? sizeof(display->High) : sizeof(display->Low)) / sizeof(unsigned long long);
+	unsigned long long *blended = (unsigned long long *)&persistence->Blended;
+
+	if (persistence->Frames <= 1) {
+		return display;
+	}
+
+	if (isHigh != persistence->IsHigh) {
+		memset(persistence->History, 0, sizeof(persistence->History));
+		persistence->IsHigh = isHigh;
+	}
+
+	memcpy(&persistence->History[persistence->Next], display, words * sizeof(unsigned long long));
+	persistence->Next = (persistence->Next + 1) % persistence->Frames;
+
+	memcpy(blended, display, words * sizeof(unsigned long long));
+	for (int frame = 0; frame < persistence->Frames; frame++) {
+		const unsigned long long *history = (const unsigned long long *)&persistence->History[frame];
+
+		for (int i = 0; i < words; i++) {
+			blended[i] |= history[i];
+		}
+	}
+
+	return &persistence->Blended;
+}
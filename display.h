@@ -0,0 +1,106 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Display buffers and the frames published from the emulation thread to the render thread.
+*/
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+/*
+Type Declarations
+*/
+
+/*
+Each row is packed into unsigned long longs with the leftmost pixel in the high bit.
+Low resolution (64 x 32) uses one word per row.
+High resolution (128 x 64) uses High[0] for the left and High[1] for the right half of each row.
+*/
+typedef union {
+	unsigned long long Low[32];
+	unsigned long long High[2][64];
+} Display;
+
+/*
+A completed frame.
+*/
+typedef struct {
+	Display Display;
+	int IsHigh;
+	unsigned long Number;
+} Frame;
+
+/*
+Lock free triple buffer of frames with one writer and one reader.
+The writer owns Slots[Back] and the reader owns Slots[Front].
+Middle holds the index of the third slot, with FRAME_FRESH set when it holds a frame the reader has not seen.
+*/
+typedef struct {
+	Frame Slots[3];
+	int Back;
+	int Middle;
+	int Front;
+} FrameTriple;
+
+#define FRAME_FRESH 4
+
+/*
+Most frames a persistence filter can blend.
+*/
+#define PERSISTENCE_MAX 8
+
+/*
+Phosphor persistence filter.
+A pixel is shown while it was lit in any of the last Frames frames, so sprites erased and drawn again within a frame or two no longer flicker.
+*/
+typedef struct {
+	Display History[PERSISTENCE_MAX];
+	Display Blended;
+	int Frames;
+	int Next;
+	int IsHigh;
+} Persistence;
+
+/*
+Function Declarations
+*/
+
+void
+frameTripleInit(FrameTriple *triple);
+
+/*
+Returns the frame the writer should fill in.
+*/
+Frame *
+frameTripleBack(FrameTriple *triple);
+
+/*
+Publishes the back frame to the reader and returns the next frame to fill in.
+*/
+Frame *
+frameTriplePublish(FrameTriple *triple);
+
+/*
+Returns the most recently published frame.
+The frame stays valid until the next call.
+*/
+const Frame *
+frameTripleFront(FrameTriple *triple);
+
+/*
+Starts a filter over the given number of frames, 1 passes frames through unchanged.
+Returns 0 on success, -1 if frames is not between 1 and PERSISTENCE_MAX.
+*/
+int
+persistenceInit(Persistence *persistence, int frames);
+
+/*
+Adds display to the history and returns the blend of the last frames.
+The blend stays valid until the next call, and history is forgotten when the resolution changes.
+*/
+const Display *
+persistenceApply(Persistence *persistence, const Display *display, int isHigh);
+
+#endif
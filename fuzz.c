@@ -0,0 +1,131 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Fuzzing harness for the machine.
+The first byte of an input picks the quirks, engine and timing model, the rest is loaded as a program and run headless for FUZZ_FRAMES frames.
+Frames are kept short so that most inputs run in microseconds, build with -DFUZZ_FRAMES to run longer.
+Builds as a libFuzzer target, or with -DFUZZ_MAIN as a program that runs every file named on the command line, or standard input, for AFL and for replaying crashes.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "chip8.h"
+#include "rom.h"
+
+#ifndef FUZZ_FRAMES
+#define FUZZ_FRAMES 30
+#endif
+
+/*
+Stops the debugging copy may make in a frame before the harness moves on to the next frame.
+*/
+#define FUZZ_STOPS 64
+
+/*
+The bits of the first byte of an input.
+The low five are QUIRK flags.
+*/
+#define FUZZ_TABLE (1 << 5)
+#define FUZZ_COSMAC (1 << 6)
+#define FUZZ_WATCH (1 << 7)
+
+/*
+Function Declarations
+*/
+
+int
+LLVMFuzzerTestOneInput(const unsigned char *data, size_t size);
+
+/*
+Global Variables
+*/
+
+/*
+Kept between inputs, loading a program resets everything but the memory pages it already owns.
+*/
+static State *Machine;
+
+/*
+Function Definitions
+*/
+
+int
+LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+	int events = CHIP8_FRAME | CHIP8_EXIT;
+
+	if (size < 1 || size - 1 > ROM_MAX_SIZE) {
+		return 0;
+	}
+
+	if (Machine == NULL) {
+		Machine = chip8Create();
+		if (Machine == NULL) {
+			abort();
+		}
+	}
+
+	chip8LoadRom(Machine, data + 1, size - 1);
+	chip8SetQuirks(Machine, data[0] & 0x1F);
+	chip8SetEngine(Machine, data[0] & FUZZ_TABLE ? CHIP8_ENGINE_TABLE : CHIP8_ENGINE_SWITCH);
+	chip8SetTiming(Machine, data[0] & FUZZ_COSMAC ? CHIP8_TIMING_COSMAC : CHIP8_TIMING_FAST);
+
+	/*
+	Watches run the debugging copy of the interpreter, on registers and memory that change often enough to stop it now and then.
+	*/
+	if (data[0] & FUZZ_WATCH) {
+		chip8SetWatchpoint(Machine, ROM_START, MEMORY_PAGE_SIZE, 1);
+		chip8WatchRegisters(Machine, 1 << 15 | WATCH_I);
+		events |= CHIP8_WATCH;
+	}
+
+	for (int frame = 0; frame < FUZZ_FRAMES; frame++) {
+		int event;
+		int stops = 0;
+
+		/*
+		Keys go down and up every frame so programs waiting for a key carry on.
+		*/
+		chip8SetKeys(Machine, frame & 1 ? 0xFFFF : 0);
+
+		do {
+			event = chip8RunUntil(Machine, Machine->TicksPerFrame, events);
+		} while (!(event & (CHIP8_FRAME | CHIP8_EXIT)) && ++stops < FUZZ_STOPS);
+
+		if (event & CHIP8_EXIT) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+#ifdef FUZZ_MAIN
+int
+main(int argc, char *argv[])
+{
+	static unsigned char data[ROM_MAX_SIZE + 2];
+
+	for (int i = argc > 1 ? 1 : 0; i < argc; i++) {
+		FILE *input = i == 0 ? stdin : fopen(argv[i], "rb");
+		size_t size;
+
+		if (input == NULL) {
+			printf("%s: could not open\n", argv[i]);
+			return 1;
+		}
+
+		size = fread(data, 1, sizeof(data), input);
+		if (input != stdin) {
+			fclose(input);
+		}
+
+		LLVMFuzzerTestOneInput(data, size);
+	}
+
+	return 0;
+}
+#endif
@@ -0,0 +1,705 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "gdbstub.h"
+
+/*
+Bytes of the registers in a g packet: v0 to vf, i and pc little endian, time and tone.
+*/
+#define REGISTER_BYTES 22
+#define REGISTER_I 16
+#define REGISTER_PC 17
+#define REGISTER_TIME 18
+#define REGISTER_TONE 19
+
+/*
+How long a stopped machine waits for the client before checking Quit, in milliseconds.
+*/
+#define SERVE_TIMEOUT 100
+
+/*
+Function Declarations
+*/
+
+static int
+hexValue(char digit);
+
+static unsigned long
+parseHex(const char **text);
+
+static int
+parseBytes(const char *text, unsigned char *bytes, size_t count);
+
+static void
+sendPacket(GdbStub *stub, const char *data);
+
+static void
+stop(GdbStub *stub, const char *reply);
+
+static void
+disconnect(GdbStub *stub, State *state);
+
+static void
+readRegisters(const State *state, unsigned char *bytes);
+
+static void
+writeRegisters(State *state, const unsigned char *bytes);
+
+static void
+handlePacket(GdbStub *stub, State *state);
+
+static int
+readClient(GdbStub *stub, State *state);
+
+static void
+serve(GdbStub *stub, State *state);
+
+/*
+Global Variables
+*/
+
+static const char TargetXml[] =
+	"<?xml version=\"1.0\"?>"
+	"<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+	"<target version=\"1.0\">"
+	"<feature name=\"org.chip8.core\">"
+	"<reg name=\"v0\" bitsize=\"8\" regnum=\"0\"/>"
+	"<reg name=\"v1\" bitsize=\"8\"/>"
+	"<reg name=\"v2\" bitsize=\"8\"/>"
+	"<reg name=\"v3\" bitsize=\"8\"/>"
+	"<reg name=\"v4\" bitsize=\"8\"/>"
+	"<reg name=\"v5\" bitsize=\"8\"/>"
+	"<reg name=\"v6\" bitsize=\"8\"/>"
+	"<reg name=\"v7\" bitsize=\"8\"/>"
+	"<reg name=\"v8\" bitsize=\"8\"/>"
+	"<reg name=\"v9\" bitsize=\"8\"/>"
+	"<reg name=\"va\" bitsize=\"8\"/>"
+	"<reg name=\"vb\" bitsize=\"8\"/>"
+	"<reg name=\"vc\" bitsize=\"8\"/>"
+	"<reg name=\"vd\" bitsize=\"8\"/>"
+	"<reg name=\"ve\" bitsize=\"8\"/>"
+	"<reg name=\"vf\" bitsize=\"8\"/>"
+	"<reg name=\"i\" bitsize=\"16\" type=\"data_ptr\"/>"
+	"<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+	"<reg name=\"time\" bitsize=\"8\"/>"
+	"<reg name=\"tone\" bitsize=\"8\"/>"
+	"</feature>"
+	"</target>";
+
+static const char Digits[] = "0123456789abcdef";
+
+/*
+Function Definitions
+*/
+
+static int
+hexValue(char digit)
+{
+	if (digit >= '0' && digit <= '9') {
+		return digit - '0';
+	}
+	if (digit >= 'a' && digit <= 'f') {
+		return digit - 'a' + 10;
+	}
+	if (digit >= 'A' && digit <= 'F') {
+		return digit - 'A' + 10;
+	}
+
+	return -1;
+}
+
+/*
+Reads hex digits from text and moves it past them.
+*/
+static unsigned long
+parseHex(const char **text)
+{
+	unsigned long value = 0;
+
+	while (hexValue(**text) != -1) {
+		value = value * 16 + hexValue(**text);
+		++*text;
+	}
+
+	return value;
+}
+
+/*
+Reads count bytes written as pairs of hex digits.
+Returns 0 on success, -1 if any character is not a hex digit.
+*/
+static int
+parseBytes(const char *text, unsigned char *bytes, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		int high = hexValue(text[i * 2]);
+		int low = hexValue(text[i * 2 + 1]);
+
+		if (high == -1 || low == -1) {
+			return -1;
+		}
+		bytes[i] = high << 4 | low;
+	}
+
+	return 0;
+}
+
+static void
+sendPacket(GdbStub *stub, const char *data)
+{
+	static char packet[GDB_PACKET_SIZE + 4];
+	unsigned char checksum = 0;
+	size_t length = strlen(data);
+	size_t sent = 0;
+
+	packet[0] = '$';
+	memcpy(packet + 1, data, length);
+	for (size_t i = 0; i < length; i++) {
+		checksum += (unsigned char)data[i];
+	}
+	packet[length + 1] = '#';
+	packet[length + 2] = Digits[checksum >> 4];
+	packet[length + 3] = Digits[checksum & 15];
+	length += 4;
+
+	while (sent < length) {
+		ssize_t count = send(stub->Connection, packet + sent, length - sent, MSG_NOSIGNAL);
+
+		if (count < 0 && errno == EINTR) {
+			continue;
+		}
+		if (count <= 0) {
+			return;
+		}
+		sent += count;
+	}
+}
+
+/*
+Stops the machine and tells the client why, unless reply is NULL.
+*/
+static void
+stop(GdbStub *stub, const char *reply)
+{
+	stub->Stopped = 1;
+	stub->Stepping = 0;
+
+	if (reply != NULL) {
+		sendPacket(stub, reply);
+	}
+}
+
+/*
+Drops the client, and the breakpoints and watchpoints it set, and lets the machine run on.
+*/
+static void
+disconnect(GdbStub *stub, State *state)
+{
+	if (stub->Connection != -1) {
+		close(stub->Connection);
+	}
+
+	stub->Connection = -1;
+	stub->Stopped = 0;
+	stub->Stepping = 0;
+	stub->Reading = 0;
+
+	if (stub->Breakpoints) {
+		for (int address = 0; address < 0x1000; address++) {
+			chip8SetBreakpoint(state, address, 0);
+		}
+		stub->Breakpoints = 0;
+	}
+
+	if (stub->Watchpoints) {
+		chip8SetWatchpoint(state, 0, 0x1000, 0);
+		stub->Watchpoints = 0;
+	}
+}
+
+static void
+readRegisters(const State *state, unsigned char *bytes)
+{
+	memcpy(bytes, state->V, 16);
+	bytes[16] = state->I;
+	bytes[17] = state->I >> 8;
+	bytes[18] = state->ProgramCounter;
+	bytes[19] = state->ProgramCounter >> 8;
+	bytes[20] = state->Time;
+	bytes[21] = state->Tone;
+}
+
+static void
+writeRegisters(State *state, const unsigned char *bytes)
+{
+	memcpy(state->V, bytes, 16);
+	state->I = (bytes[16] | bytes[17] << 8) & 0xFFF;
+	state->ProgramCounter = (bytes[18] | bytes[19] << 8) & 0xFFF;
+	state->Time = bytes[20];
+	state->Tone = bytes[21];
+}
+
+/*
+Answers the packet in stub->Packet.
+Packets this does not know are answered with an empty packet, which tells the client they are not supported.
+*/
+static void
+handlePacket(GdbStub *stub, State *state)
+{
+	static char reply[GDB_PACKET_SIZE];
+	const char *packet = stub->Packet;
+	const char *text = packet + 1;
+	unsigned char bytes[REGISTER_BYTES];
+	static unsigned char memory[GDB_PACKET_SIZE / 2];
+
+	reply[0] = '\0';
+
+	switch (packet[0]) {
+	case '?':
+		strcpy(reply, "S05");
+		break;
+	case 'g':
+		readRegisters(state, bytes);
+		for (int i = 0; i < REGISTER_BYTES; i++) {
+			reply[i * 2] = Digits[bytes[i] >> 4];
+			reply[i * 2 + 1] = Digits[bytes[i] & 15];
+		}
+		reply[REGISTER_BYTES * 2] = '\0';
+		break;
+	case 'G':
+		if (strlen(text) != REGISTER_BYTES * 2 || parseBytes(text, bytes, REGISTER_BYTES) != 0) {
+			strcpy(reply, "E01");
+			break;
+		}
+		writeRegisters(state, bytes);
+		strcpy(reply, "OK");
+		break;
+	case 'p':
+	case 'P': {
+		unsigned long number = parseHex(&text);
+		int offset;
+		int size;
+
+		if (number < REGISTER_I) {
+			offset = number;
+			size = 1;
+		} else if (number <= REGISTER_PC) {
+			offset = 16 + (number - REGISTER_I) * 2;
+			size = 2;
+		} else if (number <= REGISTER_TONE) {
+			offset = 20 + number - REGISTER_TIME;
+			size = 1;
+		} else {
+			strcpy(reply, "E01");
+			break;
+		}
+
+		readRegisters(state, bytes);
+		if (packet[0] == 'p') {
+			for (int i = 0; i < size; i++) {
+				reply[i * 2] = Digits[bytes[offset + i] >> 4];
+				reply[i * 2 + 1] = Digits[bytes[offset + i] & 15];
+			}
+			reply[size * 2] = '\0';
+		} else if (*text == '=' && strlen(text + 1) == (size_t)size * 2 && parseBytes(text + 1, bytes + offset, size) == 0) {
+			writeRegisters(state, bytes);
+			strcpy(reply, "OK");
+		} else {
+			strcpy(reply, "E01");
+		}
+		break;
+	}
+	case 'm':
+	case 'M': {
+		unsigned long address = parseHex(&text);
+		unsigned long length = *text == ',' ? (++text, parseHex(&text)) : 0;
+
+		if (address >= 0x1000 || length > 0x1000 - address || length > (GDB_PACKET_SIZE - 1) / 2) {
+			strcpy(reply, "E01");
+			break;
+		}
+
+		if (packet[0] == 'm') {
+			for (unsigned long i = 0; i < length; i++) {
+				unsigned char byte = readMemory(state, address + i);
+
+				reply[i * 2] = Digits[byte >> 4];
+				reply[i * 2 + 1] = Digits[byte & 15];
+			}
+			reply[length * 2] = '\0';
+		} else if (*text == ':' && strlen(text + 1) == length * 2 && parseBytes(text + 1, memory, length) == 0) {
+			for (unsigned long i = 0; i < length; i++) {
+				writeMemory(state, address + i, memory[i]);
+			}
+			strcpy(reply, "OK");
+		} else {
+			strcpy(reply, "E01");
+		}
+		break;
+	}
+	case 'c':
+	case 's':
+		if (*text != '\0') {
+			state->ProgramCounter = parseHex(&text) & 0xFFF;
+		}
+		stub->Stopped = 0;
+		stub->Stepping = packet[0] == 's';
+		return;
+	case 'Z':
+	case 'z': {
+		int type = hexValue(*text);
+		int enabled = packet[0] == 'Z';
+		unsigned long address;
+		unsigned long length;
+
+		++text;
+		if (*text++ != ',') {
+			strcpy(reply, "E01");
+			break;
+		}
+		address = parseHex(&text);
+		length = *text == ',' ? (++text, parseHex(&text)) : 1;
+
+		if (address >= 0x1000) {
+			strcpy(reply, "E01");
+			break;
+		}
+
+		/*
+		Software and hardware breakpoints are the same here, and only stores can be watched.
+		The counts only change for addresses that were not already set or clear, so clients may repeat a packet.
+		*/
+		if (type == 0 || type == 1) {
+			if (((state->Breakpoints[address >> 3] >> (address & 7)) & 1) != enabled) {
+				chip8SetBreakpoint(state, address, enabled);
+				stub->Breakpoints += enabled ? 1 : -1;
+			}
+			strcpy(reply, "OK");
+		} else if (type == 2) {
+			if (length > 0x1000) {
+				length = 0x1000;
+			}
+			for (unsigned long i = 0; i < length; i++) {
+				unsigned short byte = (address + i) & 0xFFF;
+
+				if (((state->Watchpoints[byte >> 3] >> (byte & 7)) & 1) != enabled) {
+					chip8SetWatchpoint(state, byte, 1, enabled);
+					stub->Watchpoints += enabled ? 1 : -1;
+				}
+			}
+			strcpy(reply, "OK");
+		}
+		break;
+	}
+	case 'D':
+		sendPacket(stub, "OK");
+		disconnect(stub, state);
+		return;
+	case 'k':
+		disconnect(stub, state);
+		return;
+	case 'H':
+		strcpy(reply, "OK");
+		break;
+	case 'q':
+		if (strncmp(packet, "qSupported", 10) == 0) {
+			snprintf(reply, sizeof(reply), "PacketSize=%x;qXfer:features:read+", GDB_PACKET_SIZE);
+		} else if (strcmp(packet, "qAttached") == 0) {
+			strcpy(reply, "1");
+		} else if (strncmp(packet, "qXfer:features:read:target.xml:", 31) == 0) {
+			unsigned long offset;
+			unsigned long length;
+
+			text = packet + 31;
+			offset = parseHex(&text);
+			length = *text == ',' ? (++text, parseHex(&text)) : 0;
+
+			if (offset >= sizeof(TargetXml) - 1) {
+				strcpy(reply, "l");
+				break;
+			}
+			if (length > sizeof(reply) - 2) {
+				length = sizeof(reply) - 2;
+			}
+			if (length >= sizeof(TargetXml) - 1 - offset) {
+				length = sizeof(TargetXml) - 1 - offset;
+				reply[0] = 'l';
+			} else {
+				reply[0] = 'm';
+			}
+			memcpy(reply + 1, TargetXml + offset, length);
+			reply[length + 1] = '\0';
+		}
+		break;
+	}
+
+	sendPacket(stub, reply);
+}
+
+/*
+Reads what the client sent and answers every whole packet in it.
+Returns -1 if the client went away.
+*/
+static int
+readClient(GdbStub *stub, State *state)
+{
+	char bytes[512];
+	ssize_t count = recv(stub->Connection, bytes, sizeof(bytes), MSG_DONTWAIT);
+
+	if (count < 0) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+	}
+	if (count == 0) {
+		return -1;
+	}
+
+	for (ssize_t i = 0; i < count && stub->Connection != -1; i++) {
+		char byte = bytes[i];
+
+		switch (stub->Reading) {
+		case 0:
+			/*
+			Between packets, ^C stops the machine and acknowledgements are ignored.
+			*/
+			if (byte == 0x03 && !stub->Stopped) {
+				stop(stub, "S02");
+			} else if (byte == '$') {
+				stub->Length = 0;
+				stub->Sum = 0;
+				stub->Reading = 1;
+			}
+			break;
+		case 1:
+			if (byte == '#') {
+				stub->Packet[stub->Length] = '\0';
+				stub->Reading = 2;
+			} else {
+				stub->Sum += (unsigned char)byte;
+				if (stub->Length < GDB_PACKET_SIZE - 1) {
+					stub->Packet[stub->Length++] = byte;
+				}
+			}
+			break;
+		case 2:
+			stub->Checksum = hexValue(byte);
+			stub->Reading = 3;
+			break;
+		case 3:
+			stub->Reading = 0;
+
+			/*
+			A packet that arrived damaged is asked for again.
+			*/
+			if (stub->Checksum == -1 || hexValue(byte) == -1 || (stub->Checksum << 4 | hexValue(byte)) != stub->Sum) {
+				send(stub->Connection, "-", 1, MSG_NOSIGNAL);
+				break;
+			}
+			send(stub->Connection, "+", 1, MSG_NOSIGNAL);
+			handlePacket(stub, state);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/*
+Answers the client until it lets the machine run, goes away, or Quit is set.
+*/
+static void
+serve(GdbStub *stub, State *state)
+{
+	while (stub->Stopped && stub->Connection != -1 && !(stub->Quit != NULL && __atomic_load_n(stub->Quit, __ATOMIC_ACQUIRE))) {
+		struct pollfd ready = { stub->Connection, POLLIN, 0 };
+
+		if (poll(&ready, 1, SERVE_TIMEOUT) > 0 && readClient(stub, state) != 0) {
+			disconnect(stub, state);
+		}
+	}
+}
+
+int
+gdbOpen(GdbStub *stub, const char *address)
+{
+	int one = 1;
+
+	memset(stub, 0, sizeof(*stub));
+	stub->Connection = -1;
+
+	if (strchr(address, '/') != NULL) {
+		struct sockaddr_un name = { 0 };
+
+		if (strlen(address) >= sizeof(name.sun_path)) {
+			return -1;
+		}
+		name.sun_family = AF_UNIX;
+		strcpy(name.sun_path, address);
+		unlink(address);
+
+		stub->Listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (stub->Listener == -1) {
+			return -1;
+		}
+		if (bind(stub->Listener, (struct sockaddr *)&name, sizeof(name)) != 0) {
+			gdbClose(stub);
+			return -1;
+		}
+	} else {
+		struct sockaddr_in name = { 0 };
+		char *end;
+		unsigned long port = strtoul(address, &end, 10);
+
+		if (*end != '\0' || port == 0 || port > 65535) {
+			return -1;
+		}
+		name.sin_family = AF_INET;
+		name.sin_port = htons(port);
+		name.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		stub->Listener = socket(AF_INET, SOCK_STREAM, 0);
+		if (stub->Listener == -1) {
+			return -1;
+		}
+		setsockopt(stub->Listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(stub->Listener, (struct sockaddr *)&name, sizeof(name)) != 0) {
+			gdbClose(stub);
+			return -1;
+		}
+	}
+
+	if (listen(stub->Listener, 1) != 0) {
+		gdbClose(stub);
+		return -1;
+	}
+
+	return 0;
+}
+
+void
+gdbClose(GdbStub *stub)
+{
+	if (stub->Connection != -1) {
+		close(stub->Connection);
+		stub->Connection = -1;
+	}
+
+	if (stub->Listener != -1) {
+		close(stub->Listener);
+		stub->Listener = -1;
+	}
+}
+
+void
+gdbPoll(GdbStub *stub, State *state)
+{
+	if (stub->Listener == -1) {
+		return;
+	}
+
+	if (stub->Connection == -1) {
+		struct pollfd ready = { stub->Listener, POLLIN, 0 };
+		int one = 1;
+
+		if (poll(&ready, 1, 0) <= 0) {
+			return;
+		}
+
+		stub->Connection = accept(stub->Listener, NULL, NULL);
+		if (stub->Connection == -1) {
+			return;
+		}
+		setsockopt(stub->Connection, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		/*
+		The client asks why the machine stopped once it has connected.
+		*/
+		stop(stub, NULL);
+	} else if (readClient(stub, state) != 0) {
+		disconnect(stub, state);
+	}
+
+	serve(stub, state);
+}
+
+int
+gdbEvents(const GdbStub *stub)
+{
+	int events = 0;
+
+	if (stub->Connection == -1) {
+		return 0;
+	}
+
+	if (stub->Breakpoints > 0) {
+		events |= CHIP8_BREAKPOINT;
+	}
+	if (stub->Watchpoints > 0) {
+		events |= CHIP8_WATCH;
+	}
+
+	return events;
+}
+
+int
+gdbTicks(const GdbStub *stub, int ticks)
+{
+	return stub->Stepping && ticks > 1 ? 1 : ticks;
+}
+
+void
+gdbRan(GdbStub *stub, State *state, int event)
+{
+	if (stub->Connection == -1) {
+		return;
+	}
+
+	if (event & CHIP8_EXIT) {
+		return;
+	}
+
+	if ((event & CHIP8_WATCH) && state->WatchHit != -1) {
+		char reply[32];
+
+		/*
+		Names the watchpoint, so the client can tell which one fired.
+		*/
+		snprintf(reply, sizeof(reply), "T05watch:%x;", state->WatchHit);
+		stop(stub, reply);
+	} else if (event & (CHIP8_BREAKPOINT | CHIP8_WATCH)) {
+		stop(stub, "S05");
+	} else if (stub->Stepping) {
+		stop(stub, "S05");
+	} else {
+		return;
+	}
+
+	serve(stub, state);
+}
+
+void
+gdbExited(GdbStub *stub, int status)
+{
+	char reply[8];
+
+	if (stub->Connection == -1) {
+		return;
+	}
+
+	snprintf(reply, sizeof(reply), "W%02x", status & 0xFF);
+	sendPacket(stub, reply);
+	close(stub->Connection);
+	stub->Connection = -1;
+}
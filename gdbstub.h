@@ -0,0 +1,102 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+GDB remote serial protocol server for a running machine.
+A client connects to a localhost TCP port or a Unix socket while the program runs, the machine stops when it connects and runs on when it detaches.
+The socket is only polled at frame boundaries, between them the machine runs the fast interpreter loop unless the client has set breakpoints or watchpoints.
+Registers are v0 to vf, i, pc, time and tone, in that order.
+*/
+
+#ifndef GDBSTUB_H
+#define GDBSTUB_H
+
+#include "chip8.h"
+
+/*
+Largest packet read or written, enough for all of memory in hex.
+*/
+#define GDB_PACKET_SIZE 0x2100
+
+/*
+Type Declarations
+*/
+
+typedef struct {
+	/*
+	Listening socket and client, -1 when there is none.
+	*/
+	int Listener;
+	int Connection;
+	/*
+	Set while the machine is stopped for the client, and for the one instruction of a step.
+	*/
+	int Stopped;
+	int Stepping;
+	/*
+	Addresses with a breakpoint and bytes watched that the client has set.
+	*/
+	int Breakpoints;
+	int Watchpoints;
+	/*
+	Stops serving a stopped machine when it becomes non-zero, may be NULL.
+	*/
+	const int *Quit;
+	/*
+	Packet being read, the sum of its bytes so far, and the first digit of the checksum sent with it.
+	*/
+	char Packet[GDB_PACKET_SIZE];
+	int Length;
+	int Reading;
+	unsigned char Sum;
+	int Checksum;
+} GdbStub;
+
+/*
+Function Declarations
+*/
+
+/*
+Listens on address, a TCP port on localhost or the path of a Unix socket if it contains a slash.
+Returns 0 on success, -1 if the socket could not be opened.
+*/
+int
+gdbOpen(GdbStub *stub, const char *address);
+
+void
+gdbClose(GdbStub *stub);
+
+/*
+Accepts a client and reads what it sent since the last frame.
+Call at frame boundaries, returns when the machine may run on.
+*/
+void
+gdbPoll(GdbStub *stub, State *state);
+
+/*
+Returns the events runUntil should stop for, 0 unless the client has breakpoints or watchpoints.
+*/
+int
+gdbEvents(const GdbStub *stub);
+
+/*
+Returns how many of ticks to run, 1 while stepping.
+*/
+int
+gdbTicks(const GdbStub *stub, int ticks);
+
+/*
+Call with the event every run stopped with.
+Stops the machine and serves the client after a step, a breakpoint or a watchpoint.
+*/
+void
+gdbRan(GdbStub *stub, State *state, int event);
+
+/*
+Tells the client the program exited with status.
+*/
+void
+gdbExited(GdbStub *stub, int status);
+
+#endif
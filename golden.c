@@ -0,0 +1,172 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Golden image regression harness.
+Runs a program headlessly for a number of frames with scripted input and hashes the display, and optionally the registers, at the end of every frame.
+With -r the hashes are written to the goldens file, else they are compared against it.
+Exits with 0 if every frame matches and 1 on the first frame that does not.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "hash.h"
+#include "rom.h"
+#include "script.h"
+
+/*
+Function Definitions
+*/
+
+int
+main(int argc, char *argv[])
+{
+	const char *script = NULL;
+	Input *inputs = NULL;
+	int inputCount = 0;
+	int nextInput = 0;
+	int frames = 600;
+	int record = 0;
+	int registers = 0;
+	int quirks = QUIRKS_DEFAULT;
+	int engine = CHIP8_ENGINE_SWITCH;
+	int timing = CHIP8_TIMING_FAST;
+	int status = 0;
+	int option;
+	FILE *goldens;
+	DisplayHash hash;
+	State *machine;
+	Rom rom;
+
+	while ((option = getopt(argc, argv, "e:i:n:q:rst:")) != -1) {
+		switch (option) {
+		case 'e':
+			engine = chip8FindEngine(optarg);
+			if (engine == -1) {
+				printf("Unknown engine %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'i':
+			script = optarg;
+			break;
+		case 'n':
+			frames = atoi(optarg);
+			break;
+		case 'q':
+			quirks = chip8FindQuirks(optarg);
+			if (quirks == -1) {
+				printf("Unknown quirk profile %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'r':
+			record = 1;
+			break;
+		case 's':
+			registers = 1;
+			break;
+		case 't':
+			timing = chip8FindTiming(optarg);
+			if (timing == -1) {
+				printf("Unknown timing model %s\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			printf("usage: %s [-r] [-s] [-e engine] [-n frames] [-i script] [-q profile] [-t timing] program goldens\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc - 2) {
+		printf("Please specify a program and a goldens file\n");
+		return 1;
+	}
+
+	if (script != NULL && readScript(script, &inputs, &inputCount) != 0) {
+		printf("%s: could not read script\n", script);
+		return 1;
+	}
+
+	status = romOpen(&rom, argv[optind]);
+	if (status != ROM_OK) {
+		printf("%s: %s\n", argv[optind], romError(&rom, status));
+		return 1;
+	}
+
+	goldens = fopen(argv[optind + 1], record ? "w" : "r");
+	if (goldens == NULL) {
+		printf("%s: could not open goldens\n", argv[optind + 1]);
+		return 1;
+	}
+
+	machine = chip8Create();
+	if (machine == NULL) {
+		printf("Out of memory\n");
+		return 1;
+	}
+	chip8LoadRom(machine, rom.Data, rom.Size);
+	chip8SetQuirks(machine, quirks);
+	chip8SetEngine(machine, engine);
+	chip8SetTiming(machine, timing);
+	displayHashInit(&hash, machine);
+
+	status = 0;
+	for (int frame = 0; frame < frames; frame++) {
+		unsigned long long displayValue;
+		unsigned long long registerValue = 0;
+		int event;
+
+		while (nextInput < inputCount && inputs[nextInput].Frame <= frame) {
+			chip8SetKeys(machine, inputs[nextInput++].Keys);
+		}
+
+		event = chip8RunUntil(machine, machine->TicksPerFrame, CHIP8_FRAME | CHIP8_EXIT);
+
+		displayValue = displayHashUpdate(&hash, machine);
+		if (registers) {
+			registerValue = registerHash(machine);
+		}
+
+		if (record) {
+			fprintf(goldens, "%d %016llx", frame, displayValue);
+			if (registers) {
+				fprintf(goldens, " %016llx", registerValue);
+			}
+			fprintf(goldens, "\n");
+		} else {
+			unsigned long long expectedDisplay;
+			unsigned long long expectedRegisters = 0;
+			int expectedFrame;
+
+			if (fscanf(goldens, "%d %llx", &expectedFrame, &expectedDisplay) != 2
+				|| (registers && fscanf(goldens, "%llx", &expectedRegisters) != 1)) {
+				printf("frame %d: no golden\n", frame);
+				status = 1;
+				break;
+			}
+			if (expectedFrame != frame || expectedDisplay != displayValue || expectedRegisters != registerValue) {
+				printf("frame %d: display %016llx registers %016llx, expected frame %d display %016llx registers %016llx\n",
+					frame, displayValue, registerValue, expectedFrame, expectedDisplay, expectedRegisters);
+				status = 1;
+				break;
+			}
+		}
+
+		if (event & CHIP8_EXIT) {
+			break;
+		}
+	}
+
+	chip8Destroy(machine);
+	fclose(goldens);
+	romClose(&rom);
+	free(inputs);
+
+	return status;
+}
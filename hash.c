@@ -0,0 +1,79 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include "hash.h"
+
+/*
+Function Declarations
+*/
+
+static unsigned long long
+mix(unsigned long long value);
+
+/*
+Function Definitions
+*/
+
+/*
+Finalizer of splitmix64.
+*/
+static unsigned long long
+mix(unsigned long long value)
+{
+	value ^= value >> 30;
+	value *= 0xbf58476d1ce4e5b9ULL;
+	value ^= value >> 27;
+	value *= 0x94d049bb133111ebULL;
+	value ^= value >> 31;
+
+	return value;
+}
+
+void
+displayHashInit(DisplayHash *hash, State *state)
+{
+	for (int i = 0; i < 64; i++) {
+		hash->Rows[i] = 0;
+	}
+	hash->Value = 0;
+	state->DirtyRows = ~0ULL;
+}
+
+unsigned long long
+displayHashUpdate(DisplayHash *hash, State *state)
+{
+	unsigned long long dirty = state->DirtyRows;
+
+	/*
+	Rows are combined with XOR so a row is swapped out of Value by XORing its old hash in again.
+	*/
+	while (dirty) {
+		int row = __builtin_ctzll(dirty);
+		unsigned long long rowHash = mix(state->DisplayBuffer.High[0][row] ^ mix(state->DisplayBuffer.High[1][row] ^ mix(row + 1)));
+
+		hash->Value ^= hash->Rows[row] ^ rowHash;
+		hash->Rows[row] = rowHash;
+		dirty &= dirty - 1;
+	}
+	state->DirtyRows = 0;
+
+	return mix(hash->Value + state->DisplayIsHigh);
+}
+
+unsigned long long
+registerHash(const State *state)
+{
+	unsigned long long value = mix(((unsigned long long)state->ProgramCounter << 16) | state->I);
+
+	for (int i = 0; i < 16; i += 8) {
+		unsigned long long word = 0;
+
+		for (int j = 0; j < 8; j++) {
+			word = (word << 8) | state->V[i + j];
+		}
+		value = mix(value ^ word);
+	}
+
+	return value;
+}
@@ -0,0 +1,50 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+64 bit hashes of a machine for regression testing.
+The display hash is kept per row and only rows the machine has marked in DirtyRows are hashed again, so hashing every frame costs little more than the rows that were drawn.
+*/
+
+#ifndef HASH_H
+#define HASH_H
+
+#include "chip8.h"
+
+/*
+Type Declarations
+*/
+
+typedef struct {
+	unsigned long long Rows[64];
+	/*
+	Combined hash of Rows.
+	*/
+	unsigned long long Value;
+} DisplayHash;
+
+/*
+Function Declarations
+*/
+
+/*
+Starts hashing the display of state.
+Marks every row dirty, as DisplayHash is the only user of DirtyRows there must be one DisplayHash per machine.
+*/
+void
+displayHashInit(DisplayHash *hash, State *state);
+
+/*
+Rehashes the dirty rows of state, clears DirtyRows and returns the hash of the display and its resolution.
+*/
+unsigned long long
+displayHashUpdate(DisplayHash *hash, State *state);
+
+/*
+Returns a hash of V, I and the program counter.
+*/
+unsigned long long
+registerHash(const State *state);
+
+#endif
@@ -0,0 +1,307 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "image.h"
+
+/*
+Pixels of the bits of a byte, most significant first.
+*/
+#define PIXEL(byte, bit) (((byte) >> (7 - (bit)) & 1) * 0xFF)
+#define EXPAND(byte) { PIXEL(byte, 0), PIXEL(byte, 1), PIXEL(byte, 2), PIXEL(byte, 3), PIXEL(byte, 4), PIXEL(byte, 5), PIXEL(byte, 6), PIXEL(byte, 7) }
+#define EXPAND4(byte) EXPAND(byte), EXPAND(byte + 1), EXPAND(byte + 2), EXPAND(byte + 3)
+#define EXPAND16(byte) EXPAND4(byte), EXPAND4(byte + 4), EXPAND4(byte + 8), EXPAND4(byte + 12)
+#define EXPAND64(byte) EXPAND16(byte), EXPAND16(byte + 16), EXPAND16(byte + 32), EXPAND16(byte + 48)
+
+/*
+Function Declarations
+*/
+
+static void
+writeBe32(unsigned char *bytes, unsigned int value);
+
+static unsigned int
+crc32(unsigned int crc, const unsigned char *bytes, size_t length);
+
+static int
+writeChunk(FILE *png, const char *type, const unsigned char *data, unsigned int length);
+
+#ifdef __SSE2__
+static __m128i
+expand16(unsigned long long bits, int pixel);
+#endif
+
+/*
+Global Variables
+*/
+
+static const unsigned char Expand[256][8] = {
+	EXPAND64(0), EXPAND64(64), EXPAND64(128), EXPAND64(192)
+};
+
+/*
+Function Definitions
+*/
+
+static void
+writeBe32(unsigned char *bytes, unsigned int value)
+{
+	bytes[0] = value >> 24;
+	bytes[1] = value >> 16;
+	bytes[2] = value >> 8;
+	bytes[3] = value;
+}
+
+/*
+Bitwise CRC-32 as used by PNG, pass 0 to start.
+*/
+static unsigned int
+crc32(unsigned int crc, const unsigned char *bytes, size_t length)
+{
+	crc = ~crc;
+
+	for (size_t i = 0; i < length; i++) {
+		crc ^= bytes[i];
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+
+	return ~crc;
+}
+
+static int
+writeChunk(FILE *png, const char *type, const unsigned char *data, unsigned int length)
+{
+	unsigned char header[8];
+	unsigned char footer[4];
+
+	writeBe32(header, length);
+	memcpy(header + 4, type, 4);
+	writeBe32(footer, crc32(crc32(0, header + 4, 4), data, length));
+
+	if (fwrite(header, 1, sizeof(header), png) != sizeof(header)
+		|| fwrite(data, 1, length, png) != length
+		|| fwrite(footer, 1, sizeof(footer), png) != sizeof(footer)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+#ifdef __SSE2__
+/*
+Returns pixels pixel to pixel + 15 of bits as bytes of 0 or 0xFF.
+The two bytes holding them are each spread over 8 lanes, and each lane keeps the one bit it stands for.
+*/
+static __m128i
+expand16(unsigned long long bits, int pixel)
+{
+	const __m128i mask = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	int first = (bits >> (56 - pixel)) & 0xFF;
+	int second = (bits >> (48 - pixel)) & 0xFF;
+	__m128i lanes = _mm_cvtsi32_si128(first | second << 8);
+
+	lanes = _mm_unpacklo_epi8(lanes, lanes);
+	lanes = _mm_unpacklo_epi16(lanes, lanes);
+	lanes = _mm_unpacklo_epi32(lanes, lanes);
+
+	return _mm_cmpeq_epi8(_mm_and_si128(lanes, mask), mask);
+}
+#endif
+
+void
+expandRow(unsigned char *pixels, unsigned long long bits, int scale)
+{
+	if (scale == 1) {
+		#ifdef __SSE2__
+		for (int pixel = 0; pixel < 64; pixel += 16) {
+			_mm_storeu_si128((__m128i *)(pixels + pixel), expand16(bits, pixel));
+		}
+		#else
+		for (int byte = 0; byte < 8; byte++) {
+			memcpy(pixels + byte * 8, Expand[(bits >> (56 - byte * 8)) & 0xFF], 8);
+		}
+		#endif
+		return;
+	}
+
+	for (int byte = 0; byte < 8; byte++) {
+		const unsigned char *expanded = Expand[(bits >> (56 - byte * 8)) & 0xFF];
+
+		for (int i = 0; i < 8; i++) {
+			memset(pixels, expanded[i], scale);
+			pixels += scale;
+		}
+	}
+}
+
+void
+expandRowRgba(unsigned int *pixels, unsigned long long bits, int scale, unsigned int on, unsigned int off)
+{
+	if (scale == 1) {
+		#ifdef __SSE2__
+		const __m128i onLanes = _mm_set1_epi32(on);
+		const __m128i offLanes = _mm_set1_epi32(off);
+
+		for (int pixel = 0; pixel < 64; pixel += 16) {
+			__m128i bytes = expand16(bits, pixel);
+			__m128i words[2] = { _mm_unpacklo_epi8(bytes, bytes), _mm_unpackhi_epi8(bytes, bytes) };
+
+			for (int i = 0; i < 2; i++) {
+				__m128i masks[2] = { _mm_unpacklo_epi16(words[i], words[i]), _mm_unpackhi_epi16(words[i], words[i]) };
+
+				for (int j = 0; j < 2; j++) {
+					__m128i blended = _mm_or_si128(_mm_and_si128(masks[j], onLanes), _mm_andnot_si128(masks[j], offLanes));
+
+					_mm_storeu_si128((__m128i *)(pixels + pixel + i * 8 + j * 4), blended);
+				}
+			}
+		}
+		return;
+		#endif
+	}
+
+	for (int i = 0; i < 64; i++) {
+		unsigned int color = (bits >> (63 - i)) & 1 ? on : off;
+
+		for (int j = 0; j < scale; j++) {
+			*pixels++ = color;
+		}
+	}
+}
+
+void
+expandDisplay(const Display *display, int isHigh, unsigned char *pixels)
+{
+	if (isHigh) {
+		for (int y = 0; y < 64; y++) {
+			expandRow(pixels, display->High[0][y], 1);
+			expandRow(pixels + 64, display->High[1][y], 1);
+			pixels += IMAGE_WIDTH;
+		}
+	} else {
+		for (int y = 0; y < 32; y++) {
+			expandRow(pixels, display->Low[y], 2);
+			memcpy(pixels + IMAGE_WIDTH, pixels, IMAGE_WIDTH);
+			pixels += 2 * IMAGE_WIDTH;
+		}
+	}
+}
+
+void
+expandDisplayRgba(const Display *display, int isHigh, unsigned int *pixels, unsigned int on, unsigned int off)
+{
+	if (isHigh) {
+		for (int y = 0; y < 64; y++) {
+			expandRowRgba(pixels, display->High[0][y], 1, on, off);
+			expandRowRgba(pixels + 64, display->High[1][y], 1, on, off);
+			pixels += IMAGE_WIDTH;
+		}
+	} else {
+		for (int y = 0; y < 32; y++) {
+			expandRowRgba(pixels, display->Low[y], 2, on, off);
+			memcpy(pixels + IMAGE_WIDTH, pixels, IMAGE_WIDTH * sizeof(unsigned int));
+			pixels += 2 * IMAGE_WIDTH;
+		}
+	}
+}
+
+int
+pngWrite(const char *path, const unsigned char *pixels)
+{
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	/*
+	Each row is a filter type byte followed by its pixels.
+	The zlib stream is a 2 byte header, one stored block with a 5 byte header, and a 4 byte Adler-32.
+	*/
+	enum {
+		ROW_SIZE = 1 + IMAGE_WIDTH,
+		RAW_SIZE = ROW_SIZE * IMAGE_HEIGHT,
+		ZLIB_SIZE = 2 + 5 + RAW_SIZE + 4
+	};
+	unsigned char zlib[ZLIB_SIZE];
+	unsigned char header[13];
+	unsigned char *raw = zlib + 7;
+	unsigned int a = 1;
+	unsigned int b = 0;
+	int status = 0;
+	FILE *png = fopen(path, "wb");
+
+	if (png == NULL) {
+		return -1;
+	}
+
+	writeBe32(header, IMAGE_WIDTH);
+	writeBe32(header + 4, IMAGE_HEIGHT);
+	header[8] = 8;
+	header[9] = 0;
+	header[10] = 0;
+	header[11] = 0;
+	header[12] = 0;
+
+	zlib[0] = 0x78;
+	zlib[1] = 0x01;
+	zlib[2] = 1;
+	zlib[3] = RAW_SIZE & 0xFF;
+	zlib[4] = RAW_SIZE >> 8;
+	zlib[5] = ~RAW_SIZE & 0xFF;
+	zlib[6] = (~RAW_SIZE >> 8) & 0xFF;
+
+	for (int y = 0; y < IMAGE_HEIGHT; y++) {
+		raw[y * ROW_SIZE] = 0;
+		memcpy(raw + y * ROW_SIZE + 1, pixels + y * IMAGE_WIDTH, IMAGE_WIDTH);
+	}
+
+	for (int i = 0; i < RAW_SIZE; i++) {
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	writeBe32(raw + RAW_SIZE, (b << 16) | a);
+
+	if (fwrite(signature, 1, sizeof(signature), png) != sizeof(signature)
+		|| writeChunk(png, "IHDR", header, sizeof(header)) != 0
+		|| writeChunk(png, "IDAT", zlib, ZLIB_SIZE) != 0
+		|| writeChunk(png, "IEND", header, 0) != 0) {
+		status = -1;
+	}
+
+	if (fclose(png) != 0) {
+		status = -1;
+	}
+
+	return status;
+}
+
+FILE *
+y4mOpen(const char *path)
+{
+	FILE *y4m = fopen(path, "wb");
+
+	if (y4m == NULL) {
+		return NULL;
+	}
+
+	if (fprintf(y4m, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 Cmono\n", IMAGE_WIDTH, IMAGE_HEIGHT) < 0) {
+		fclose(y4m);
+		return NULL;
+	}
+
+	return y4m;
+}
+
+int
+y4mWrite(FILE *y4m, const unsigned char *pixels)
+{
+	if (fputs("FRAME\n", y4m) == EOF || fwrite(pixels, 1, IMAGE_WIDTH * IMAGE_HEIGHT, y4m) != IMAGE_WIDTH * IMAGE_HEIGHT) {
+		return -1;
+	}
+
+	return 0;
+}
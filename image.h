@@ -0,0 +1,75 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Display buffers as images.
+The packed bit rows of a display are expanded to 8 bit grayscale or 32 bit color pixels at any integer scale, for the window, PNG files and YUV4MPEG2 videos.
+Rows at scale 1 are expanded 16 pixels at a time with SSE2 where it is available, else through a table of the pixels of each byte.
+*/
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdio.h>
+
+#include "display.h"
+
+/*
+Images are always high resolution, low resolution displays are drawn with 2 x 2 pixels.
+*/
+#define IMAGE_WIDTH 128
+#define IMAGE_HEIGHT 64
+
+/*
+Function Declarations
+*/
+
+/*
+Expands the 64 bits of a display row, most significant first, into 64 * scale pixels of 0 for off and 255 for on.
+*/
+void
+expandRow(unsigned char *pixels, unsigned long long bits, int scale);
+
+/*
+Expands a display row into 64 * scale 32 bit pixels of on or off.
+Colors are stored as given, so they should be in the byte order of the pixel format they are used with.
+*/
+void
+expandRowRgba(unsigned int *pixels, unsigned long long bits, int scale, unsigned int on, unsigned int off);
+
+/*
+Expands display into IMAGE_WIDTH * IMAGE_HEIGHT pixels, 0 for off and 255 for on.
+*/
+void
+expandDisplay(const Display *display, int isHigh, unsigned char *pixels);
+
+/*
+Expands display into IMAGE_WIDTH * IMAGE_HEIGHT 32 bit pixels of on or off.
+*/
+void
+expandDisplayRgba(const Display *display, int isHigh, unsigned int *pixels, unsigned int on, unsigned int off);
+
+/*
+Writes pixels as a grayscale PNG file.
+The image data is stored rather than compressed, it is small and the file is written in one pass.
+Returns 0 on success, -1 if the file could not be written.
+*/
+int
+pngWrite(const char *path, const unsigned char *pixels);
+
+/*
+Opens path for writing a 60 frames per second monochrome YUV4MPEG2 video.
+Close it with fclose.
+*/
+FILE *
+y4mOpen(const char *path);
+
+/*
+Appends a frame of pixels to a video opened with y4mOpen.
+Returns 0 on success, -1 if the file could not be written.
+*/
+int
+y4mWrite(FILE *y4m, const unsigned char *pixels);
+
+#endif
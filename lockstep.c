@@ -0,0 +1,445 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Differential testing of the interpreters.
+Runs every program given with the switch engine and a second engine side by side on the same input, seeding rand the same for both before every frame.
+After every frame V, I, the program counter, the stack counter and a hash of the display are compared.
+At the first frame that differs both machines are run again from a checkpoint one instruction at a time, and the instructions up to the first that differs are printed.
+Exits with 0 if every program ran the same on both engines and 1 if any did not.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "disasm.h"
+#include "hash.h"
+#include "rom.h"
+#include "script.h"
+
+/*
+Frames between checkpoints.
+A replay starts from the checkpoint before the last, so it covers at least CHECKPOINT_FRAMES frames before the one that differs.
+*/
+#define CHECKPOINT_FRAMES 64
+#define HISTORY_FRAMES (2 * CHECKPOINT_FRAMES)
+
+/*
+Most instructions the trace window can hold.
+*/
+#define MAX_WINDOW 256
+
+/*
+Type Declarations
+*/
+
+/*
+A machine after one frame or one instruction.
+*/
+typedef struct {
+	unsigned char V[16];
+	unsigned short I;
+	unsigned short ProgramCounter;
+	int StackCounter;
+	unsigned long long Display;
+	int Exited;
+} Snapshot;
+
+/*
+One instruction run by both engines, with the machines after it.
+*/
+typedef struct {
+	int Frame;
+	unsigned short ProgramCounter;
+	unsigned short Opcode;
+	Snapshot After[2];
+} Step;
+
+/*
+One engine and what it ran.
+*/
+typedef struct {
+	State *Machine;
+	DisplayHash Hash;
+	/*
+	The machine at the start of the last two checkpoint frames, indexed by checkpoint number modulo 2.
+	*/
+	State *Checkpoints[2];
+	/*
+	Instructions run in each of the last HISTORY_FRAMES frames.
+	*/
+	unsigned long long Instructions[HISTORY_FRAMES];
+} Side;
+
+/*
+Function Declarations
+*/
+
+void
+takeSnapshot(Snapshot *snapshot, State *state, DisplayHash *hash, int exited);
+
+int
+sameSnapshot(const Snapshot *a, const Snapshot *b);
+
+void
+printSnapshot(const char *engine, const Snapshot *snapshot);
+
+void
+printStep(const Step *step, int differs);
+
+int
+replay(Side sides[2], int from, int to);
+
+int
+runProgram(Side sides[2], const char *path);
+
+/*
+Global Variables
+*/
+
+static const char *Engines[2] = { "switch", "table" };
+static int Engine = CHIP8_ENGINE_TABLE;
+static int Quirks = QUIRKS_DEFAULT;
+static int Timing = CHIP8_TIMING_FAST;
+static int Frames = 600;
+static int Window = 16;
+static Input *Inputs = NULL;
+static int InputCount = 0;
+
+/*
+Keys held in each of the last HISTORY_FRAMES frames.
+*/
+static unsigned short Keys[HISTORY_FRAMES];
+
+/*
+Function Definitions
+*/
+
+void
+takeSnapshot(Snapshot *snapshot, State *state, DisplayHash *hash, int exited)
+{
+	memcpy(snapshot->V, state->V, sizeof(snapshot->V));
+	snapshot->I = state->I;
+	snapshot->ProgramCounter = state->ProgramCounter;
+	snapshot->StackCounter = state->StackCounter;
+	snapshot->Display = displayHashUpdate(hash, state);
+	snapshot->Exited = exited;
+}
+
+int
+sameSnapshot(const Snapshot *a, const Snapshot *b)
+{
+	return memcmp(a->V, b->V, sizeof(a->V)) == 0
+		&& a->I == b->I
+		&& a->ProgramCounter == b->ProgramCounter
+		&& a->StackCounter == b->StackCounter
+		&& a->Display == b->Display
+		&& a->Exited == b->Exited;
+}
+
+void
+printSnapshot(const char *engine, const Snapshot *snapshot)
+{
+	printf("\t\t%-6s v", engine);
+	for (int i = 0; i < 16; i++) {
+		printf(" %02x", snapshot->V[i]);
+	}
+	printf("  i %03x  pc %03x  sp %2d  display %016llx%s\n",
+		snapshot->I, snapshot->ProgramCounter, snapshot->StackCounter, snapshot->Display, snapshot->Exited ? "  exited" : "");
+}
+
+/*
+Prints an instruction and the machine after it, from both engines when they differ.
+*/
+void
+printStep(const Step *step, int differs)
+{
+	char text[32];
+
+	disassemble(step->Opcode, text, sizeof(text));
+	printf("%c\tframe %d  %03x  %04x  %s\n", differs ? '>' : ' ', step->Frame, step->ProgramCounter, step->Opcode, text);
+
+	printSnapshot(differs ? Engines[0] : "", &step->After[0]);
+	if (differs) {
+		printSnapshot(Engines[1], &step->After[1]);
+	}
+}
+
+/*
+Runs both engines again from the checkpoint at frame from through frame to.
+Each frame a copy of each machine is stepped one instruction at a time for as many instructions as it ran in the frame, and the machine itself is then run for the whole frame as before.
+Prints the last Window instructions up to the first after which the machines differ.
+Returns 0 if there is one, -1 if the engines only differ at the end of a frame.
+*/
+int
+replay(Side sides[2], int from, int to)
+{
+	static Step steps[MAX_WINDOW];
+	State *frames[2];
+	State *stepping[2];
+	Snapshot *after[2];
+	unsigned short *opcodes[2];
+	int count = 0;
+	int status = -1;
+
+	for (int side = 0; side < 2; side++) {
+		frames[side] = chip8Clone(sides[side].Checkpoints[from / CHECKPOINT_FRAMES % 2]);
+		stepping[side] = chip8Clone(frames[side]);
+		/*
+		Every instruction takes at least a tick, and the first of a frame is the frame start.
+		*/
+		after[side] = malloc((frames[side]->TicksPerFrame + 1) * sizeof(Snapshot));
+		opcodes[side] = malloc(frames[side]->TicksPerFrame * sizeof(unsigned short));
+		if (frames[side] == NULL || stepping[side] == NULL || after[side] == NULL || opcodes[side] == NULL) {
+			printf("Out of memory\n");
+			exit(1);
+		}
+	}
+
+	for (int frame = from; frame <= to && status == -1; frame++) {
+		unsigned long long ran[2];
+		unsigned long long most;
+
+		for (int side = 0; side < 2; side++) {
+			DisplayHash hash;
+
+			ran[side] = sides[side].Instructions[frame % HISTORY_FRAMES];
+			if (ran[side] > (unsigned long long)frames[side]->TicksPerFrame) {
+				ran[side] = frames[side]->TicksPerFrame;
+			}
+
+			chip8SetKeys(frames[side], Keys[frame % HISTORY_FRAMES]);
+			chip8CloneInto(stepping[side], frames[side]);
+			displayHashInit(&hash, stepping[side]);
+			takeSnapshot(&after[side][0], stepping[side], &hash, 0);
+
+			/*
+			Seeded as for the whole frame, so each engine draws the random numbers it drew before.
+			*/
+			srand(frame + 1);
+			for (unsigned long long i = 0; i < ran[side]; i++) {
+				unsigned short pc = stepping[side]->ProgramCounter;
+				int exited;
+
+				opcodes[side][i] = readMemory(stepping[side], pc) << 8 | readMemory(stepping[side], pc + 1);
+				exited = chip8RunUntil(stepping[side], 1, 0) & CHIP8_EXIT;
+
+				takeSnapshot(&after[side][i + 1], stepping[side], &hash, exited);
+			}
+		}
+
+		/*
+		An engine that ran fewer instructions stays where it stopped, so running more shows as a difference.
+		*/
+		most = ran[0] > ran[1] ? ran[0] : ran[1];
+		for (unsigned long long i = 0; i < most && status == -1; i++) {
+			Step *step = &steps[count++ % Window];
+			int ranBy = i < ran[0] ? 0 : 1;
+
+			step->Frame = frame;
+			step->ProgramCounter = after[ranBy][i].ProgramCounter & 0xFFF;
+			step->Opcode = opcodes[ranBy][i];
+
+			for (int side = 0; side < 2; side++) {
+				step->After[side] = after[side][i < ran[side] ? i + 1 : ran[side]];
+			}
+
+			if (!sameSnapshot(&step->After[0], &step->After[1])) {
+				status = 0;
+			}
+		}
+
+		for (int side = 0; side < 2; side++) {
+			srand(frame + 1);
+			chip8RunUntil(frames[side], frames[side]->TicksPerFrame, CHIP8_FRAME | CHIP8_EXIT);
+		}
+	}
+
+	for (int i = count > Window ? count - Window : 0; i < count; i++) {
+		printStep(&steps[i % Window], status == 0 && i == count - 1);
+	}
+
+	for (int side = 0; side < 2; side++) {
+		chip8Destroy(frames[side]);
+		chip8Destroy(stepping[side]);
+		free(after[side]);
+		free(opcodes[side]);
+	}
+
+	return status;
+}
+
+/*
+Returns 0 if the program ran the same on both engines, 1 if it did not, -1 if it could not be run.
+*/
+int
+runProgram(Side sides[2], const char *path)
+{
+	unsigned short held = 0;
+	int nextInput = 0;
+	int status;
+	Rom rom;
+
+	status = romOpen(&rom, path);
+	if (status != ROM_OK) {
+		printf("%s: %s\n", path, romError(&rom, status));
+		return -1;
+	}
+
+	for (int side = 0; side < 2; side++) {
+		State *machine = sides[side].Machine;
+
+		chip8LoadRom(machine, rom.Data, rom.Size);
+		chip8SetQuirks(machine, Quirks);
+		chip8SetEngine(machine, side == 0 ? CHIP8_ENGINE_SWITCH : Engine);
+		chip8SetTiming(machine, Timing);
+		displayHashInit(&sides[side].Hash, machine);
+	}
+	romClose(&rom);
+
+	for (int frame = 0; frame < Frames; frame++) {
+		Snapshot after[2];
+
+		while (nextInput < InputCount && Inputs[nextInput].Frame <= frame) {
+			held = Inputs[nextInput++].Keys;
+		}
+		Keys[frame % HISTORY_FRAMES] = held;
+
+		for (int side = 0; side < 2; side++) {
+			State *machine = sides[side].Machine;
+			unsigned long long before;
+			int event;
+
+			chip8SetKeys(machine, held);
+			if (frame % CHECKPOINT_FRAMES == 0) {
+				chip8CloneInto(sides[side].Checkpoints[frame / CHECKPOINT_FRAMES % 2], machine);
+			}
+
+			/*
+			Both engines draw the same random numbers in a frame as long as they run the same instructions.
+			*/
+			srand(frame + 1);
+			before = machine->Instructions;
+			event = chip8RunUntil(machine, machine->TicksPerFrame, CHIP8_FRAME | CHIP8_EXIT);
+			sides[side].Instructions[frame % HISTORY_FRAMES] = machine->Instructions - before;
+
+			takeSnapshot(&after[side], machine, &sides[side].Hash, event & CHIP8_EXIT ? 1 : 0);
+		}
+
+		if (!sameSnapshot(&after[0], &after[1])) {
+			int from = frame < CHECKPOINT_FRAMES ? 0 : (frame / CHECKPOINT_FRAMES - 1) * CHECKPOINT_FRAMES;
+
+			printf("%s: frame %d differs\n", path, frame);
+			if (replay(sides, from, frame) != 0) {
+				printf("\tat the end of the frame\n");
+				printSnapshot(Engines[0], &after[0]);
+				printSnapshot(Engines[1], &after[1]);
+			}
+			return 1;
+		}
+
+		if (after[0].Exited) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *script = NULL;
+	int differ = 0;
+	int failed = 0;
+	int option;
+	Side sides[2];
+
+	while ((option = getopt(argc, argv, "e:i:n:q:t:w:")) != -1) {
+		switch (option) {
+		case 'e':
+			Engine = chip8FindEngine(optarg);
+			if (Engine == -1) {
+				printf("Unknown engine %s\n", optarg);
+				return 1;
+			}
+			Engines[1] = optarg;
+			break;
+		case 'i':
+			script = optarg;
+			break;
+		case 'n':
+			Frames = atoi(optarg);
+			break;
+		case 'q':
+			Quirks = chip8FindQuirks(optarg);
+			if (Quirks == -1) {
+				printf("Unknown quirk profile %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 't':
+			Timing = chip8FindTiming(optarg);
+			if (Timing == -1) {
+				printf("Unknown timing model %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'w':
+			Window = atoi(optarg);
+			if (Window < 1 || Window > MAX_WINDOW) {
+				printf("The window must be between 1 and %d instructions\n", MAX_WINDOW);
+				return 1;
+			}
+			break;
+		default:
+			printf("usage: %s [-e engine] [-n frames] [-i script] [-q profile] [-t timing] [-w instructions] program...\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind == argc) {
+		printf("Please specify at least one program\n");
+		return 1;
+	}
+
+	if (script != NULL && readScript(script, &Inputs, &InputCount) != 0) {
+		printf("%s: could not read script\n", script);
+		return 1;
+	}
+
+	for (int side = 0; side < 2; side++) {
+		sides[side].Machine = chip8Create();
+		sides[side].Checkpoints[0] = chip8Create();
+		sides[side].Checkpoints[1] = chip8Create();
+		if (sides[side].Machine == NULL || sides[side].Checkpoints[0] == NULL || sides[side].Checkpoints[1] == NULL) {
+			printf("Out of memory\n");
+			return 1;
+		}
+	}
+
+	for (int i = optind; i < argc; i++) {
+		int status = runProgram(sides, argv[i]);
+
+		if (status == 1) {
+			++differ;
+		} else if (status == -1) {
+			++failed;
+		}
+	}
+
+	printf("%d programs, %d differ, %d could not be run\n", argc - optind, differ, failed);
+
+	for (int side = 0; side < 2; side++) {
+		chip8Destroy(sides[side].Machine);
+		chip8Destroy(sides[side].Checkpoints[0]);
+		chip8Destroy(sides[side].Checkpoints[1]);
+	}
+	free(Inputs);
+
+	return differ || failed ? 1 : 0;
+}
@@ -25,1877 +25,773 @@ freely, subject to the following restrictions:
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <raylib.h>
 
+#include "audio.h"
+#include "chip8.h"
+#include "display.h"
+#include "gdbstub.h"
+#include "image.h"
+#include "metrics.h"
+#include "rom.h"
+#include "shmframe.h"
+#include "viewport.h"
 
-/*
-Type Declarations
-*/
-
-typedef struct {
-	unsigned short ProgramCounter;
-	unsigned short Stack[32];
-	int StackCounter;
-	union {
-		unsigned long long Low[32];
-		unsigned long long High[2][64];
-	} DisplayBuffer;
-	int DisplayIsHigh;
-	int UsingCompatibility;
-	unsigned char Time;
-	unsigned char Tone;
-	unsigned short I;
-	unsigned short Keys;
-	unsigned short KeyMask;
-	int WaitingForKeyPress;
-	unsigned char V[16];
-	unsigned char Memory[0x1000];
-} State;
-
-/*
-Function Declarations
-*/
-
-/*
-Chip8 Declarations
-*/
 
 /*
-0x00E0
-clear
-Clears the screen.
+Frontend Declarations
 */
-void
-clearScreen(void);
 
-/*
-0x00EE
-ret
-Returns from subroutine.
-*/
-void
-subroutineReturn(void);
+unsigned short
+readKeys(void);
 
-/*
-DEPRECATED
-0x00FA
-compatability
-Only for backwards compatability.
-Causes "save" and "restore" opcodes to leave I register unchanged.
-*/
-void
-compatability(void);
+int
+runFrame(Tone *tone);
 
-/*
-0x0NNN
-jump addr
-Jumps to address NNN
-NNN must be even.
-NNN must be in range 0x200 to 0xFFE.
-*/
 void
-jump(unsigned short address);
+countFrame(unsigned long long nanoseconds);
 
-/*
-0xBNNN
-jump addr, v0
-Jumps to address NNN + v0
-NNN must be even.
-v0 must be even.
-NNN + v0 must be even.
-NNN + v0 must be in range 0x200 to 0xFFE.
-*/
-void
-jumpv0(unsigned short address);
+int
+drainTone(Tone *tone, FILE *wav);
 
-/*
-0x1NNN
-call addr
-Calls subroutine at address NNN.
-NNN must be even.
-NNN must be in range 0x200 to 0xFFE.
-*/
 void
-call(unsigned short address);
-
+playTone(void *buffer, unsigned int frames);
 
-/*
-0x3XYY
-skip.eq vX, value
-Skips the next instruction if vX is equal to value.
-*/
-void
-skipEqvXValue(unsigned char registerX, unsigned char value);
+void *
+emulate(void *wav);
 
-/*
-0x3XY0
-skip.eq vX, Vy
-Skips the next instruction if vX is equal to vY.
-*/
 void
-skipEqvXvY(unsigned char registerX, unsigned char registerY);
+drawDisplayBuffer(const Frame *frame, const Viewport *viewport);
 
 /*
-0xEX9E
-skip.eq vX, key
-Skips the next instruction if the key with the value of the lower 4 bits of vX is being pressed.
+Frames of a headless run to write as PNG files.
 */
-void
-skipvXKey(unsigned char registerX);
+#define MAX_PNGS 64
 
 /*
-0x4XKK
-skip.ne vX, value
-Skips the next instruction if vX is not equal to value.
+Global Variables
 */
-void
-skipNevXValue(unsigned char registerX, unsigned char value);
 
-/*
-0x9XY0
-skip.ne vY, vY
-Skips the next instruction if vY is not equal to vY.
-*/
-void
-skipNevXvY(unsigned char registerX, unsigned char registerY);
+static State *Machine;
+static Tone ToneAudio;
 
 /*
-0xEXA1
-skip.ne vX, key
-Skips the next instruction if the key with the value of the lower 4 bits of vX is not being pressed.
+Owned by whichever thread runs the machine.
 */
-void
-skipNevXKey(unsigned char registerX);
+static GdbStub Gdb = { -1, -1 };
 
 /*
-0x6XKK
-load vX, value
-Loads register vX with value.
+Each thread writes its own part.
 */
-void
-loadvXValue(unsigned char registerX, unsigned char value);
+static Metrics Counters;
 
 /*
-0xFX0A
-load vX, key
-If no key is currently pressed wait until one is, then load vX with the lowest key currently being pressed.
-Loaded key will not be registered as pressed again until it is let go and re-pressed.
+Written by whichever thread runs the machine, NULL unless frames are exported.
 */
-void
-loadvXKey(unsigned char registerX);
+static SharedFrame *Exported;
 
 /*
-0x8XY0
-load vX, vY
-Loads register vX with value of vY.
+Owned by whichever thread runs the machine, passes frames through unless -f is given.
 */
-void
-loadvXvY(unsigned char registerX, unsigned char registerY);
+static Persistence Phosphor;
 
 /*
-0xFX07
-load vX, time
-Loads register vX with the value of the time register.
+Shared between the emulation thread and the render thread.
 */
-void
-loadvXTime(unsigned char registerX);
+static FrameTriple Frames;
+static unsigned short SharedKeys;
+static int EmulationStatus;
+static int EmulationDone;
+static int RenderDone;
 
 /*
-0xFX15
-load time, vX
-Loads the time register with the value of register vX.
+Owned by the render thread.
 */
-void
-loadTimevX(unsigned char registerX);
+static Texture2D DisplayTexture;
+static unsigned int DisplayPixels[IMAGE_WIDTH * IMAGE_HEIGHT];
 
 /*
-0xFX18
-load tone, vX
-Loads the tone register with the value of register vX.
+Function Definitions
 */
-void
-loadTonevX(unsigned char registerX);
 
 /*
-0xANNN
-load i, addr
-Loads the I register with NNN.
-NNN must be in the range 0x200 to 0xFFF
+Frontend Definitions
 */
-void
-loadI(unsigned short address);
 
 /*
-0x7XKK
-add vX, value
-Adds KK to register vX.
+Reads the keyboard.
+Returns a bitmask of the keys being pressed.
 */
-void
-addvXValue(unsigned char registerX, unsigned char value);
+unsigned short
+readKeys(void)
+{
+	/*
+	Clear Keys
+	*/
+	unsigned short keys = 0;
+	
+	/*
+	Key 0
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_ONE) << 0;
 
-/*
-0x8XY4
-add vX, vY
-Adds register vY to register vX.
-Register v15 is set to 1 if result overflows.
-Else register v15 is set to 0.
-*/
-void
-addvXvY(unsigned char registerX, unsigned char registerY);
+	/*
+	Key 1
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_TWO) << 1;
 
-/*
-0xFX1E
-add i, vX
-Adds the value of register vX to the I register.
-*/
-void
-addIvX(unsigned char registerX);
+	/*
+	Key 2
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_THREE) << 2;
 
-/*
-0x8XY1
-or vX, vY
-Bitwise ORs the value of register vY into register vX.
-*/
-void
-orvXvY(unsigned char registerX, unsigned char registerY);
+	/*
+	Key 3
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_FOUR) << 3;
 
-/*
-0x8XY2
-and vX, vY
-Bitwise ANDs the value of register vY into register vX.
-*/
-void
-andvXvY(unsigned char registerX, unsigned char registerY);
+	/*
+	Key 4
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_Q) << 4;
 
-/*
-0x8XY3
-xor vX, vY
-Bitwise XORs the value of register vY into register vX.
-*/
-void
-xorvXvY(unsigned char registerX, unsigned char registerY);
+	/*
+	Key 5
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_W) << 5;
 
-/*
-0x8XY5
-sub vX, vY
-Subtracts the value of register vY from register vX.
-Register v15 is set to 1 if the result underflows.
-Else register v15 is set to 0.
-*/
-void
-subvXvY(unsigned char registerX, unsigned char registerY);
+	/*
+	Key 6
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_E) << 6;
+	
+	/*
+	Key 7
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_R) << 7;
 
-/*
-0x8X06
-shr vX
-Shifts the value of register vX right one bit.
-Register v15 is set to 1 if register vX was odd before the operation.
-Else register v15 is set to 0.
-*/
-void
-shrvX(unsigned char registerX);
+	/*
+	Key 8
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_A) << 8;
 
-/*
-0x8XY7
-dif vX, vY
-Sets register vX to the value of register vY minus register vX.
-Register v15 is set to 1 if the result would be less than 0.
-Else register v15 is set to 0.
-*/
-void
-difvXvY(unsigned char registerX, unsigned char registerY);
+	/*
+	Key 9
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_S) << 9;
 
-/*
-0x8X0E
-shl vX
-Shifts the value of register vX left one bit.
-Register v15 is set to 1 if the high bit of register vX was set before the operation.
-Else register v15 is set to 0.
-*/
-void
-shlvX(unsigned char registerX);
+	/*
+	Key a
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_D) << 10;
 
-/*
-0xCXKK
-rnd vX, mask
-Sets register vX to the bitwise AND of a random number and KK.
-*/
-void
-rndvXMask(unsigned char registerX, unsigned char mask);
+	/*
+	Key b
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_F) << 11;
 
-/*
-0xDXYN
-draw xY, vY, rows
-Draws an image to the display buffer.
-The image is 8 pixels wide and N pixels long.
-The image is pointed to by the I register.
-The top left corner of the image will be at (register vX, register vY).
-Pixels are blitted to the display buffer using XOR.
-If this causes one or more pixels to be erased register v15 is set to 1.
-Else register v15 is set to 0.
-N must be in the range 1 to 15.
-*/
-void
-drawvXvYRows(unsigned char registerX, unsigned char registerY, unsigned char rows);
+	/*
+	Key c
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_Z) << 12;
 
-/*
-0xFX29
-hex vX
-Points the I register to an image of a hex character representing the low 4 bits of register vX.
-The image is 4 pixels wide and 5 pixels long.
-*/
-void
-hexvX(unsigned char registerX);
+	/*
+	Key d
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_X) << 13;
 
-/*
-0xFX33
-bcd vX
-Stores a BCD(Binary Coded Decimal) representation of the value of register vX into memory starting at the byte pointed to by the I register. 
-Most significant digit is loaded first.
-*/
-void
-bcdvX(unsigned char registerX);
+	/*
+	Key e
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_C) << 14;
 
-/*
-0xFX55
-save vX
-Stores the values of registers v0 to vX in memory starting at the byte pointed to by the I register.
-*/
-void
-savevX(unsigned char registerX);
+	/*
+	Key f
+	*/
+	keys |= (unsigned short)IsKeyDown(KEY_V) << 15;
 
-/*
-0xFX65
-restore vX
-Loads the values in memory starting at the byte pointed to by the I register into registers v0 to vX.
-*/
-void
-restorevX(unsigned char registerX);
+	return keys;
+}
 
 /*
-DEBUG OPCODE
-0x001X
-exit value
-Causes the program to exit with the value of X.
-X must be in the range 0 to 1.
+Runs one frame of ticks and updates the time and tone registers.
+Tone register edges are passed to tone with the tick they happen on.
+Returns -1 while the program is running, else the program's exit value.
 */
 int
-programExitValue(unsigned char value);
-
-/*
-Super Chip8 Declarations
-*/
-
-/*
-0x00Cn
-scdown n
-Scrolls the display buffer down by n pixels.
-*/
-void
-scrollDownN(unsigned char n);
+runFrame(Tone *tone)
+{
+	/*
+	Do N ticks, instructions or machine cycles depending on the timing model
+	*/
+	int ticksPerFrame = Machine->TicksPerFrame;
+	int toneOn = tone->Gate;
+	int status = -1;
+	int tick;
 
-/*
-0x00FB
-scright
-Scrolls the display buffer right 4 pixels.
-*/
-void
-scrollRight(void);
+	/*
+	Cycles the last instruction ran over the previous frame by come out of this one.
+	*/
+	for (tick = Machine->FrameTick; tick < ticksPerFrame && status == -1;) {
+		int executed;
 
-/*
-0x00FC
-scleft
-Scrolls the display buffer left 4 pixels.
-*/
-void
-scrollLeft(void);
+		/*
+		Draws wait for the end of the frame from FrameTick, so it has to follow tick however small the steps are.
+		*/
+		Machine->FrameTick = tick;
 
-/*
-0x00FE
-low
-Sets the display buffer to the low resolution (64 x 32).
-This is the default state.
-*/
-void
-displayBufferLow(void);
+		#ifdef AOT
+		status = aotRun(Machine, ticksPerFrame - tick, &executed);
+		#else
+		int event = runUntil(Machine, gdbTicks(&Gdb, ticksPerFrame - tick), CHIP8_TONE | gdbEvents(&Gdb), &executed);
 
-/*
-0x00FF
-high
-Sets the display buffer to the high resolution (128 x 64).
-*/
-void
-displayBufferHigh(void);
+		if (event == CHIP8_EXIT) {
+			status = Machine->ExitValue;
+		}
+		#endif
 
-/*
-0xDXY0
-xdraw vX, vY
-Draws an image to the display buffer.
-The image is 16 pixels wide and 16 pixels long.
-The image is pointed to by the I register.
-The top left corner of the image will be at (register vX, register vY).
-Pixels are blitted to the display buffer using XOR.
-If this causes one or more pixels to be erased register v15 is set to 1.
-Else register v15 is set to 0.
-*/
-void
-drawvXvY(unsigned char registerX, unsigned char registerY);
+		tick += executed;
 
-/*
-0x00FD
-exit
-Causes the program to exit with a successful exit status.
-*/
-int
-programExit(void);
+		if ((Machine->Tone > 0) != toneOn) {
+			toneOn = !toneOn;
+			toneEdge(tone, toneOn, tick < ticksPerFrame ? tick : ticksPerFrame);
+		}
 
-/*
-Global Variables
-*/
+		#ifndef AOT
+		gdbRan(&Gdb, Machine, event);
+		#endif
+	}
 
-static State MachineState;
+	if (status != -1) {
+		return status;
+	}
 
-/*
-Function Definitions
-*/
+	Machine->FrameTick = tick - ticksPerFrame;
+	chip8TickTimers(Machine);
 
-/*
-Chip8 Definitions
-*/
+	/*
+	A tone running out at the end of the frame is silent from the start of the next one.
+	*/
+	if ((Machine->Tone > 0) != toneOn) {
+		toneEdge(tone, !toneOn, ticksPerFrame);
+	}
 
-/*
-0x00E0
-clear
-Clears the screen.
-*/
-void
-clearScreen(void)
-{
-	memset(MachineState.DisplayBuffer.High, 0, sizeof(MachineState.DisplayBuffer.High));
-}
+	toneEndFrame(tone, ticksPerFrame);
 
-/*
-0x00EE
-ret
-Returns from subroutine.
-*/
-void
-subroutineReturn(void)
-{
-	MachineState.ProgramCounter = MachineState.Stack[MachineState.StackCounter--];
+	return -1;
 }
 
 /*
-DEPRECATED
-0x00FA
-compatability
-Only for backwards compatability.
-Causes "save" and "restore" opcodes to leave I register unchanged.
+Publishes the counters of the machine after a frame that took nanoseconds to run.
 */
 void
-compatability(void)
+countFrame(unsigned long long nanoseconds)
 {
-	MachineState.UsingCompatibility = 1;
-}
+	EmulationMetrics *counters = &Counters.Emulation;
 
-/*
-0x0NNN
-jump addr
-Jumps to address NNN
-NNN must be even.
-NNN must be in range 0x200 to 0xFFE.
-*/
-void
-jump(unsigned short address)
-{
-	MachineState.ProgramCounter = address - 2;
+	metricsSet(&counters->Instructions, Machine->Instructions);
+	metricsSet(&counters->Draws, Machine->Draws);
+	metricsSet(&counters->Collisions, Machine->Collisions);
+	metricsAdd(&counters->Frames, 1);
+	metricsAdd(&counters->EmulateNanoseconds, nanoseconds);
+	if (Machine->WaitingForKeyPress) {
+		metricsAdd(&counters->KeyWaitFrames, 1);
+	}
 }
 
 /*
-0xBNNN
-jump addr, v0
-Jumps to address NNN + v0
-NNN must be even.
-v0 must be even.
-NNN + v0 must be even.
-NNN + v0 must be in range 0x200 to 0xFFE.
+Moves every sample in the tone ring buffer into a WAV file.
 */
-void
-jumpv0(unsigned short address)
+int
+drainTone(Tone *tone, FILE *wav)
 {
-	MachineState.ProgramCounter = address + MachineState.V[0] - 2;
-}
+	short samples[512];
+	unsigned int count;
 
-/*
-0x1NNN
-call addr
-Calls subroutine at address NNN.
-NNN must be even.
-NNN must be in range 0x200 to 0xFFE.
-*/
-void
-call(unsigned short address)
-{
-	MachineState.Stack[++MachineState.StackCounter] = MachineState.ProgramCounter;
-	MachineState.ProgramCounter = address - 2;
-}
+	while ((count = toneAvailable(tone)) > 0) {
+		if (count > sizeof(samples) / sizeof(samples[0])) {
+			count = sizeof(samples) / sizeof(samples[0]);
+		}
 
+		toneRead(tone, samples, count);
 
-/*
-0x3XYY
-skip.eq vX, value
-Skips the next instruction if vX is equal to value.
-*/
-void
-skipEqvXValue(unsigned char registerX, unsigned char value)
-{
-	if (MachineState.V[registerX] == value) {
-		MachineState.ProgramCounter += 2;
+		if (wavWrite(wav, samples, count) != 0) {
+			return -1;
+		}
 	}
-}
 
-/*
-0x3XY0
-skip.eq vX, Vy
-Skips the next instruction if vX is equal to vY.
-*/
-void
-skipEqvXvY(unsigned char registerX, unsigned char registerY)
-{
-	if (MachineState.V[registerX] == MachineState.V[registerY]) {
-		MachineState.ProgramCounter += 2;
-	}
+	return 0;
 }
 
 /*
-0xEX9E
-skip.eq vX, key
-Skips the next instruction if the key with the value of the lower 4 bits of vX is being pressed.
+Audio device callback, pulls samples from the tone ring buffer.
 */
 void
-skipvXKey(unsigned char registerX)
+playTone(void *buffer, unsigned int frames)
 {
-	if ((1 << (MachineState.V[registerX] & 0xF)) & MachineState.Keys) {
-		MachineState.ProgramCounter += 2;
-	}
+	toneRead(&ToneAudio, buffer, frames);
 }
 
 /*
-0x4XKK
-skip.ne vX, value
-Skips the next instruction if vX is not equal to value.
+Emulation thread.
+Runs frames at 60 Hz and publishes each finished DisplayBuffer to the render thread.
+Tone samples are written to wav when it is not NULL.
 */
-void
-skipNevXValue(unsigned char registerX, unsigned char value)
+void *
+emulate(void *wav)
 {
-	if (MachineState.V[registerX] != value) {
-		MachineState.ProgramCounter += 2;	
-	}	
-}
+	long framePeriod = 1000000000 / 60;
+	struct timespec deadline;
+	struct timespec now;
+	Frame *frame = frameTripleBack(&Frames);
+	unsigned long frameNumber = 0;
+	int status = -1;
 
-/*
-0x9XY0
-skip.ne vY, vY
-Skips the next instruction if vY is not equal to vY.
-*/
-void
-skipNevXvY(unsigned char registerX, unsigned char registerY)
-{
-	if (MachineState.V[registerX] != MachineState.V[registerY]) {
-		MachineState.ProgramCounter += 2;
-	}
-}
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
 
-/*
-0xEXA1
-skip.ne vX, key
-Skips the next instruction if the key with the value of the lower 4 bits of vX is not being pressed.
-*/
-void
-skipNevXKey(unsigned char registerX)
-{
-	if (!((1 << (MachineState.V[registerX] & 0xF)) & MachineState.Keys)) {
-		MachineState.ProgramCounter += 2;
-	}
-}
+	while (status == -1 && !__atomic_load_n(&RenderDone, __ATOMIC_ACQUIRE)) {
+		const Display *display;
+		unsigned long long started;
 
-/*
-0x6XKK
-load vX, value
-Loads register vX with value.
-*/
-void
-loadvXValue(unsigned char registerX, unsigned char value)
-{
-	MachineState.V[registerX] = value;
-}
+		chip8SetKeys(Machine, __atomic_load_n(&SharedKeys, __ATOMIC_RELAXED));
+		gdbPoll(&Gdb, Machine);
 
-/*
-0xFX0A
-load vX, key
-If no key is currently pressed wait until one is, then load vX with the lowest key currently being pressed.
-Loaded key will not be registered as pressed again until it is let go and re-pressed.
-*/
-void
-loadvXKey(unsigned char registerX)
-{
-	if ((MachineState.Keys & MachineState.KeyMask)== 0) {
-		MachineState.WaitingForKeyPress = 1;
-	} else {
-		MachineState.WaitingForKeyPress = 0;
-		unsigned char lowestKey = 0;
-		while ((MachineState.Keys & MachineState.KeyMask) & (1 << lowestKey)) {
-			++lowestKey;
-		}		
-		MachineState.V[registerX] = lowestKey;
-		MachineState.KeyMask &= ~(1 << lowestKey);	
+		started = metricsNow();
+		status = runFrame(&ToneAudio);
+		countFrame(metricsNow() - started);
+
+		if (wav != NULL && drainTone(&ToneAudio, wav) != 0) {
+			printf("Could not write the WAV file\n");
+			status = 1;
+		}
+
+		display = chip8Framebuffer(Machine, &frame->IsHigh);
+		frame->Display = *persistenceApply(&Phosphor, display, frame->IsHigh);
+		/*
+		Frames are numbered from 1, so the empty slots the reader starts with are frame 0.
+		*/
+		frame->Number = ++frameNumber;
+		if (Exported != NULL) {
+			sharedFramePublish(Exported, &frame->Display, frame->IsHigh, frame->Number, Machine->Keys);
+		}
+		frame = frameTriplePublish(&Frames);
+
+		/*
+		Sleep until the next frame is due.
+		If we fell more than a frame behind start again from now instead of running a burst of frames to catch up.
+		*/
+		deadline.tv_nsec += framePeriod;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_nsec -= 1000000000;
+			++deadline.tv_sec;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ((now.tv_sec - deadline.tv_sec) * 1000000000 + (now.tv_nsec - deadline.tv_nsec) > framePeriod) {
+			metricsAdd(&Counters.Emulation.Late, ((now.tv_sec - deadline.tv_sec) * 1000000000 + (now.tv_nsec - deadline.tv_nsec)) / framePeriod);
+			deadline = now;
+		}
+
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
 	}
+
+	EmulationStatus = status;
+	__atomic_store_n(&EmulationDone, 1, __ATOMIC_RELEASE);
+
+	return NULL;
 }
 
 /*
-0x8XY0
-load vX, vY
-Loads register vX with value of vY.
+Draws frame into viewport.
 */
 void
-loadvXvY(unsigned char registerX, unsigned char registerY)
+drawDisplayBuffer(const Frame *frame, const Viewport *viewport)
 {
-	MachineState.V[registerX] = MachineState.V[registerY];
-}
+	static const Color on = WHITE;
+	static const Color off = BLACK;
+	unsigned int onPixel;
+	unsigned int offPixel;
+	Rectangle source = { 0, 0, IMAGE_WIDTH, IMAGE_HEIGHT };
+	Rectangle destination = { viewport->X, viewport->Y, viewport->Width, viewport->Height };
+	Vector2 origin = { 0, 0 };
 
-/*
-0xFX07
-load vX, time
-Loads register vX with the value of the time register.
-*/
-void
-loadvXTime(unsigned char registerX)
-{
-	MachineState.V[registerX] = MachineState.Time;
-}
-
-/*
-0xFX15
-load time, vX
-Loads the time register with the value of register vX.
-*/
-void
-loadTimevX(unsigned char registerX)
-{
-	MachineState.Time = MachineState.V[registerX];
-}
-
-/*
-0xFX18
-load tone, vX
-Loads the tone register with the value of register vX.
-*/
-void
-loadTonevX(unsigned char registerX)
-{
-	MachineState.Tone = MachineState.V[registerX];
-}
-
-/*
-0xANNN
-load i, addr
-Loads the I register with NNN.
-NNN must be in the range 0x200 to 0xFFF
-*/
-void
-loadI(unsigned short address)
-{
-	MachineState.I = address;
-}
-
-/*
-0x7XKK
-add vX, value
-Adds KK to register vX.
-*/
-void
-addvXValue(unsigned char registerX, unsigned char value)
-{
-	MachineState.V[registerX] += value;
-}
-
-/*
-0x8XY4
-add vX, vY
-Adds register vY to register vX.
-Register v15 is set to 1 if result overflows.
-Else register v15 is set to 0.
-*/
-void
-addvXvY(unsigned char registerX, unsigned char registerY)
-{
-	MachineState.V[registerX] += MachineState.V[registerY];
-}
-
-/*
-0xFX1E
-add i, vX
-Adds the value of register vX to the I register.
-*/
-void
-addIvX(unsigned char registerX)
-{
-	MachineState.I += MachineState.V[registerX];	
-}
-
-/*
-0x8XY1
-or vX, vY
-Bitwise ORs the value of register vY into register vX.
-*/
-void
-orvXvY(unsigned char registerX, unsigned char registerY)
-{
-	MachineState.V[registerX] |= MachineState.V[registerY];
-}
-
-/*
-0x8XY2
-and vX, vY
-Bitwise ANDs the value of register vY into register vX.
-*/
-void
-andvXvY(unsigned char registerX, unsigned char registerY)
-{
-	MachineState.V[registerX] &= MachineState.V[registerY];
-}
-
-/*
-0x8XY3
-xor vX, vY
-Bitwise XORs the value of register vY into register vX.
-*/
-void
-xorvXvY(unsigned char registerX, unsigned char registerY)
-{
-	MachineState.V[registerX] ^= MachineState.V[registerY];
-}
-
-/*
-0x8XY5
-sub vX, vY
-Subtracts the value of register vY from register vX.
-Register v15 is set to 1 if the result underflows.
-Else register v15 is set to 0.
-*/
-void
-subvXvY(unsigned char registerX, unsigned char registerY)
-{
-	MachineState.V[15] = MachineState.V[registerX] < MachineState.V[registerY];
-	
-	MachineState.V[registerX] -= MachineState.V[registerY];
-}
-
-/*
-0x8X06
-shr vX
-Shifts the value of register vX right one bit.
-Register v15 is set to 1 if register vX was odd before the operation.
-Else register v15 is set to 0.
-*/
-void
-shrvX(unsigned char registerX)
-{
-	MachineState.V[15] = MachineState.V[registerX] & 1;
-	
-	MachineState.V[registerX] >>= 1;
-}
-
-/*
-0x8XY7
-dif vX, vY
-Sets register vX to the value of register vY minus register vX.
-Register v15 is set to 1 if the result would be less than 0.
-Else register v15 is set to 0.
-*/
-void
-difvXvY(unsigned char registerX, unsigned char registerY)
-{
-	MachineState.V[15] = MachineState.V[registerX] > MachineState.V[registerY];
-	
-	MachineState.V[registerX] = MachineState.V[registerY] - MachineState.V[registerX];
-}
-
-/*
-0x8X0E
-shl vX
-Shifts the value of register vX left one bit.
-Register v15 is set to 1 if the high bit of register vX was set before the operation.
-Else register v15 is set to 0.
-*/
-void
-shlvX(unsigned char registerX)
-{
-	MachineState.V[15] = MachineState.V[registerX] & 0x80;
+	/*
+	Colors are copied as bytes so they land in R8G8B8A8 order on any machine.
+	*/
+	memcpy(&onPixel, &on, sizeof(onPixel));
+	memcpy(&offPixel, &off, sizeof(offPixel));
 
-	MachineState.V[registerX] <<= 1;
+	expandDisplayRgba(&frame->Display, frame->IsHigh, DisplayPixels, onPixel, offPixel);
+	UpdateTexture(DisplayTexture, DisplayPixels);
+	DrawTexturePro(DisplayTexture, source, destination, origin, 0, WHITE);
 }
 
-/*
-0xCXKK
-rnd vX, mask
-Sets register vX to the bitwise AND of a random number and KK.
-*/
-void
-rndvXMask(unsigned char registerX, unsigned char mask)
-{
-	MachineState.V[registerX] = (unsigned char)rand() & mask;
-}
-
-/*
-0XDXYN
-draw xY, vY, rows
-Draws an image to the display buffer.
-The image is 8 pixels wide and N pixels long.
-The image is pointed to by the I register.
-The top left corner of the image will be at (register vX, register vY).
-Pixels are blitted to the display buffer using XOR.
-If this causes one or more pixels to be erased register v15 is set to 1.
-Else register v15 is set to 0.
-N must be in the range 1 to 15.
-*/
-void
-drawvXvYRows(unsigned char registerX, unsigned char registerY, unsigned char rows)
+int
+main(int argc, char *argv[])
 {
-	int x = MachineState.V[registerX];
-	int y = MachineState.V[registerY];
-
-	if (MachineState.DisplayIsHigh) {
-		for (int i = 0; i < y; i++) {
-			unsigned long long firstHalf = ((unsigned long long)MachineState.Memory[MachineState.I + i] << 56) >> x; 
-			unsigned long long secondHalf = (unsigned long long)MachineState.Memory[MachineState.I + i] << (120 - x);
-
-			if ((MachineState.DisplayBuffer.High[0][y + i] & firstHalf) || (MachineState.DisplayBuffer.High[1][i] & secondHalf)) {
-				MachineState.V[15] = 1;						
-			} else {
-				MachineState.V[15] = 0;	
+	unsigned int sampleRate = 44100;
+	unsigned long bufferFrames = 512;
+	long headlessFrames = -1;
+	const char *wavPath = NULL;
+	FILE *wav = NULL;
+	const char *videoPath = NULL;
+	FILE *video = NULL;
+	const char *gdbAddress = NULL;
+	const char *metricsTarget = NULL;
+	double metricsInterval = 1;
+	const char *sharedName = NULL;
+	long pngFrames[MAX_PNGS];
+	const char *pngPaths[MAX_PNGS];
+	int pngCount = 0;
+	int quirks = QUIRKS_DEFAULT;
+	int engine = CHIP8_ENGINE_SWITCH;
+	int timing = CHIP8_TIMING_FAST;
+	char *end;
+	int status = -1;
+	int option;
+
+	while ((option = getopt(argc, argv, "b:e:f:g:i:m:n:p:q:s:t:v:w:")) != -1) {
+		switch (option) {
+		case 'b':
+			bufferFrames = strtoul(optarg, &end, 0);
+			if (*end != '\0' || optarg[0] == '-' || bufferFrames == 0 || bufferFrames > TONE_MAX_BUFFER_FRAMES) {
+				printf("Please give the audio buffer as 1 to %d samples\n", TONE_MAX_BUFFER_FRAMES);
+				return 1;
 			}
-			
-			MachineState.DisplayBuffer.High[0][y + i] ^= firstHalf;
-			MachineState.DisplayBuffer.High[0][y + i] ^= secondHalf;			
-		}
-	} else {
-		for (int i = 0; i < rows; i++) {
-			unsigned long long line = (unsigned long long)MachineState.Memory[MachineState.I + i] << (56 - x);
-			if (MachineState.DisplayBuffer.Low[y + i] & line) {
-				MachineState.V[15] = 1;
-			} else {
-				MachineState.V[15] = 0;
+			break;
+		case 'e':
+			engine = chip8FindEngine(optarg);
+			if (engine == -1) {
+				printf("Unknown engine %s\n", optarg);
+				return 1;
 			}
-			
-			MachineState.DisplayBuffer.Low[y + i] ^= line;
+			break;
+		case 'f':
+			if (persistenceInit(&Phosphor, strtol(optarg, NULL, 0)) != 0) {
+				printf("Persistence must be between 1 and %d frames\n", PERSISTENCE_MAX);
+				return 1;
+			}
+			break;
+		case 'g':
+			#ifdef AOT
+			printf("Precompiled programs cannot be debugged\n");
+			return 1;
+			#else
+			gdbAddress = optarg;
+			#endif
+			break;
+		case 'i':
+			metricsInterval = strtod(optarg, NULL);
+			break;
+		case 'm':
+			metricsTarget = optarg;
+			break;
+		case 'n':
+			headlessFrames = strtol(optarg, NULL, 0);
+			break;
+		case 'p':
+			if (pngCount == MAX_PNGS) {
+				printf("At most %d PNG frames can be written\n", MAX_PNGS);
+				return 1;
+			}
+			pngFrames[pngCount] = strtol(optarg, &end, 0);
+			if (*end != ':') {
+				printf("Please give PNG frames as frame:file.png\n");
+				return 1;
+			}
+			pngPaths[pngCount++] = end + 1;
+			break;
+		case 'q':
+			quirks = chip8FindQuirks(optarg);
+			if (quirks == -1) {
+				printf("Unknown quirk profile %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 's':
+			sharedName = optarg;
+			break;
+		case 't':
+			timing = chip8FindTiming(optarg);
+			if (timing == -1) {
+				printf("Unknown timing model %s\n", optarg);
+				return 1;
+			}
+			#ifdef AOT
+			if (timing != CHIP8_TIMING_FAST) {
+				printf("Precompiled programs only run with fast timing\n");
+				return 1;
+			}
+			#endif
+			break;
+		case 'v':
+			videoPath = optarg;
+			break;
+		case 'w':
+			wavPath = optarg;
+			break;
+		default:
+			printf("usage: %s [-b samples] [-e engine] [-f frames] [-g port|socket] [-i seconds] [-m target] [-n frames] [-p frame:file.png] [-q profile] [-s name] [-t timing] [-v file.y4m] [-w file.wav] program\n", argv[0]);
+			return 1;
 		}
 	}
-}
-
-/*
-0xFX29
-hex vX
-Points the I register to an image of a hex character representing the low 4 bits of register vX.
-The image is 4 pixels wide and 5 pixels long.
-*/
-void
-hexvX(unsigned char registerX)
-{
-	MachineState.I = (MachineState.V[registerX] & 0xF) << 4;
-}
 
-/*
-0xFX33
-bcd vX
-Stores a BCD(Binary Coded Decimal) representation of the value of register vX into memory starting at the byte pointed to by the I register. 
-Most significant digit is loaded first.
-*/
-void
-bcdvX(unsigned char registerX)
-{
-	MachineState.Memory[MachineState.I] = MachineState.V[registerX] / 100;
-	MachineState.Memory[MachineState.I+1] = (MachineState.V[registerX] % 100) / 10;
-	MachineState.Memory[MachineState.I+2] = (MachineState.V[registerX] % 10);
-}
-
-/*
-0xFX55
-save vX
-Stores the values of registers v0 to vX in memory starting at the byte pointed to by the I register.
-*/
-void
-savevX(unsigned char registerX)
-{
-	for (int i = 0; i <= registerX; i++) {
-		MachineState.Memory[MachineState.I + i] = MachineState.V[i];
+	if (optind != argc - 1) {
+		printf("Please specify one program file\n");	
+		return 0;
 	}
 
-	if (!MachineState.UsingCompatibility) {
-		MachineState.I += registerX + 1;
+	Machine = chip8Create();
+	if (Machine == NULL) {
+		printf("Out of memory\n");
+		return 1;
 	}
-}
 
-/*
-0xFX65
-restore vX
-Loads the values in memory starting at the byte pointed to by the I register into registers v0 to vX.
-*/
-void
-restorevX(unsigned char registerX)
-{
-	for (int i = 0; i <= registerX; i++) {
-		MachineState.V[i] = MachineState.Memory[MachineState.I + i];
+	/*
+	Load program into memory
+	*/
+	Rom rom;
+	int romStatus = romOpen(&rom, argv[optind]);
+
+	if (romStatus != ROM_OK) {
+		printf("%s: %s\n", argv[optind], romError(&rom, romStatus));
+		return 1;
 	}
 
-	if (!MachineState.UsingCompatibility) {
-		MachineState.I += registerX + 1;
+	if (romIsUnaligned(&rom)) {
+		printf("%s: Warning: program is an odd number of bytes long\n", argv[optind]);
 	}
-}
 
-/*
-DEBUG OPCODE
-0x001X
-exit value
-Causes the program to exit with the value of X.
-X must be in the range 0 to 1.
-*/
-int
-programExitValue(unsigned char value)
-{
-	return value;
-}
+	chip8LoadRom(Machine, rom.Data, rom.Size);
+	chip8SetQuirks(Machine, quirks);
+	chip8SetEngine(Machine, engine);
+	chip8SetTiming(Machine, timing);
 
-/*
-Super Chip8 Definitions
-*/
-// TODO
-/*
-0x00Cn
-scdown n
-Scrolls the display buffer down by n pixels.
-*/
-void
-scrollDownN(unsigned char n)
-{
-/*
-	Possibly delay execution of this opcode until drawing in Low mode?
-*/
-	if (MachineState.DisplayIsHigh) {
-		/*
-			Copy DisplayBuffer lines that will be kept to their new spots.
-		*/
-		for (int i = 0; i < (64 - n); i++) {
-			MachineState.DisplayBuffer.High[0][i+n] = MachineState.DisplayBuffer.High[0][i];
-			MachineState.DisplayBuffer.High[1][i+n] = MachineState.DisplayBuffer.High[1][i];
-		}
-		/*
-			Zero copied lines.
-			This should work but if stuff breaks check here first.
-		*/
-		memset(MachineState.DisplayBuffer.High, 0, n * 2 * sizeof(unsigned long long));
-	} else {
-		/*
-			Copy DisplayBuffer lines that will be kept to their new spots.
-		*/
-		for (int i = 0; i < (32 - n); i++) {
-			MachineState.DisplayBuffer.Low[i+n] = MachineState.DisplayBuffer.Low[i];
-		}
-		/*
-			Zero copied lines.
-			This should work but if stuff breaks check here first.
-		*/
-		memset(MachineState.DisplayBuffer.Low, 0, n * sizeof(unsigned long long));
-	}	
-}
+	romClose(&rom);
 
-/*
-0x00FB
-scright
-Scrolls the display buffer right 4 pixels.
-*/
-void
-scrollRight(void)
-{
-/*
-	Possibly delay execution of this opcode until drawing in Low mode?
-*/
-	if (MachineState.DisplayIsHigh) {
-		for (int i = 0; i < 64; i++) {
-			/*
-				Shift the second line over
-			*/
-			MachineState.DisplayBuffer.High[1][i] >>= 4;
-			/*
-				Copy last 4 bits of first half into first 4 bits of second half
-			*/
-			MachineState.DisplayBuffer.High[1][i] |= (MachineState.DisplayBuffer.High[0][i] & 0xf) << 60;
-			/*
-				Shift the first line over.
-			*/
-			MachineState.DisplayBuffer.High[0][i] >>= 4;	
-		}
-	} else {
-		for (int i = 0; i < 32; i++) {
-			MachineState.DisplayBuffer.Low[i] >>= 4;
-		}
+	if (toneInit(&ToneAudio, sampleRate, 60, bufferFrames) != 0) {
+		printf("Could not allocate the tone buffer\n");
+		return 1;
 	}
-}
 
-/*
-0x00FC
-scleft
-Scrolls the display buffer left 4 pixels.
-*/
-void
-scrollLeft(void)
-{
-/*
-	Possibly delay execution of this opcode until drawing in Low mode?
-*/
-	if (MachineState.DisplayIsHigh) {
-		for (int i = 0; i < 64; i++) {
-			/*
-				Shift the first line over
-			*/
-			MachineState.DisplayBuffer.High[0][i] <<= 4;
-			/*
-				Copy first 4 bits of second half into last 4 bits of first half
-			*/
-			MachineState.DisplayBuffer.High[0][i] |= (MachineState.DisplayBuffer.High[0][i] & ((unsigned long long)0xf << 60)) >> 60;
-			/*
-				Shift the second line over.
-			*/
-			MachineState.DisplayBuffer.High[1][i] <<= 4;	
-		}
-	} else {
-		for (int i = 0; i < 32; i++) {
-			MachineState.DisplayBuffer.Low[i] <<= 4;
+	if (wavPath != NULL) {
+		wav = wavOpen(wavPath, sampleRate);
+		if (wav == NULL) {
+			printf("Could not open %s\n", wavPath);
+			return 1;
 		}
 	}
-}
-
-/*
-0x00FE
-low
-Sets the display buffer to the low resolution (64 x 32).
-This is the default state.
-*/
-void
-displayBufferLow(void)
-{
-	MachineState.DisplayIsHigh = 0;	
-}
-
-/*
-0x00FF
-high
-Sets the display buffer to the high resolution (128 x 64).
-*/
-void
-displayBufferHigh(void)
-{
-	MachineState.DisplayIsHigh = 1;
-}
 
-/*
-0xDXY0
-xdraw vX, vY
-Draws an image to the display buffer.
-The image is 16 pixels wide and 16 pixels long.
-The image is pointed to by the I register.
-The top left corner of the image will be at (register vX, register vY).
-Pixels are blitted to the display buffer using XOR.
-If this causes one or more pixels to be erased register v15 is set to 1.
-Else register v15 is set to 0.
-*/
-void
-drawvXvY(unsigned char registerX, unsigned char registerY)
-{
-	int x = MachineState.V[registerX];
-	int y = MachineState.V[registerY];
-
-	if (MachineState.DisplayIsHigh) {
-		for (int i = 0; i < 16; i++) {
-			unsigned long long firstHalf = ((((unsigned long long)MachineState.Memory[MachineState.I + 2 * i] << 8) | ((unsigned long long)MachineState.Memory[MachineState.I + 2 * i + 1])) << 48) >> x;
-			unsigned long long secondHalf = ((MachineState.Memory[MachineState.I + 2 * i] << 8) | (MachineState.Memory[MachineState.I + 2 * i + 1])) << (111 - x);
-
-			if ((MachineState.DisplayBuffer.High[0][y + i] & firstHalf) || (MachineState.DisplayBuffer.High[1][y + i] & secondHalf)) {
-				MachineState.V[15] = 1;
-			} else {
-				MachineState.V[15] = 0;
-			}
-			
-			MachineState.DisplayBuffer.High[0][y + i] ^= firstHalf;
-			MachineState.DisplayBuffer.High[1][y + i] ^= secondHalf;
-		}				
-	} else {
-		for (int i = 0; i < 16; i++) {
-			unsigned long long line = ((unsigned long long)MachineState.Memory[MachineState.I + 2 * i] << 8) | ((unsigned long long)MachineState.Memory[MachineState.I + 2 * i + 1]) << (56 - x);
-			
-			if (MachineState.DisplayBuffer.Low[y + i] & line) {
-				MachineState.V[15] = 1;
-			} else {
-				MachineState.V[15] = 0;
-			}
-
-			MachineState.DisplayBuffer.Low[y + i] ^= line;
+	if (videoPath != NULL) {
+		video = y4mOpen(videoPath);
+		if (video == NULL) {
+			printf("Could not open %s\n", videoPath);
+			return 1;
 		}
-	}	
-}
-
-/*
-0x00FD
-exit
-Causes the program to exit with a successful exit status.
-*/
-int
-programExit(void) {
-	return 0;
-}
-
-
-int
-main(int argc, char *argv[])
-{
-	if (argc != 2) {
-		printf("Please specify one program file\n");	
-		return 0;
 	}
 
-	/*
-	Init MachineState
-	*/
-	MachineState.ProgramCounter = 0x200;
-	MachineState.StackCounter = -1;
-	memset(MachineState.DisplayBuffer.High, 0, sizeof(MachineState.DisplayBuffer.High));	
-	MachineState.DisplayIsHigh = 0;
-	MachineState.UsingCompatibility = 0;
-	MachineState.Time = 0;
-	MachineState.Tone = 0;
-	MachineState.I = 0;
-	MachineState.Keys = 0;
-	MachineState.KeyMask = 0xFFFF;
-	MachineState.WaitingForKeyPress = 0;
-	memset(MachineState.V, 0, sizeof(MachineState.V));
-	memset(MachineState.Stack, 0, sizeof(MachineState.Stack));
-	memset(MachineState.Memory, 0, sizeof(MachineState.Memory));
-	
-	/*
-	Init Memory with hex characters at 0xN0
-	*/
-	
-	/*
-	####
-	#  #
-	#  #
-	####
-	*/
-	MachineState.Memory[0x00] = 0xf0;
-	MachineState.Memory[0x00 + 1] = 0x90;
-	MachineState.Memory[0x00 + 2] = 0x90;
-	MachineState.Memory[0x00 + 3] = 0x90;
-	MachineState.Memory[0x00 + 4] = 0xf0;
-
-	/*
-	  #
-	 ##
-	  #
-	 ###	
-	*/
-	MachineState.Memory[0x10] = 0x20;
-	MachineState.Memory[0x10 + 1] = 0x60;
-	MachineState.Memory[0x10 + 2] = 0x20;
-	MachineState.Memory[0x10 + 3] = 0x20;
-	MachineState.Memory[0x10 + 4] = 0x70;
-
-	/*
-	####
-	   #
-	####
-	#
-	####
-	*/
-	MachineState.Memory[0x20] = 0xf0;
-	MachineState.Memory[0x20 + 1] = 0x10;
-	MachineState.Memory[0x20 + 2] = 0xf0;
-	MachineState.Memory[0x20 + 3] = 0x80;
-	MachineState.Memory[0x20 + 4] = 0xf0;
-
-	/*
-	####
-	   #
-	####
-	   #
-	####	
-	*/
-	MachineState.Memory[0x30] = 0xf0;
-	MachineState.Memory[0x30 + 1] = 0x10;
-	MachineState.Memory[0x30 + 2] = 0xf0;
-	MachineState.Memory[0x30 + 3] = 0x10;
-	MachineState.Memory[0x30 + 4] = 0xf0;
-
-	/*
-	#  #
-	#  #
-	####
-	   #
-	   #
-	*/
-	MachineState.Memory[0x40] = 0x90;
-	MachineState.Memory[0x40 + 1] = 0x90;
-	MachineState.Memory[0x40 + 2] = 0xf0;
-	MachineState.Memory[0x40 + 3] = 0x10;
-	MachineState.Memory[0x40 + 4] = 0x10;
-
-	/*
-	####
-	#
-	####
-	   #
-	####
-	*/
-	MachineState.Memory[0x50] = 0xf0;
-	MachineState.Memory[0x50 + 1] = 0x80;
-	MachineState.Memory[0x50 + 2] = 0xf0;
-	MachineState.Memory[0x50 + 3] = 0x10;
-	MachineState.Memory[0x50 + 4] = 0xf0;
-
-	/*
-	####
-	#
-	####
-	#  #
-	####	
-	*/
-	MachineState.Memory[0x60] = 0xf0;
-	MachineState.Memory[0x60 + 1] = 0x80;
-	MachineState.Memory[0x60 + 2] = 0xf0;
-	MachineState.Memory[0x60 + 3] = 0x90;
-	MachineState.Memory[0x60 + 4] = 0xf0;
-	
-	/*
-	####
-	   #
-	  #
-	 #
-	 #
-	*/
-	MachineState.Memory[0x70] = 0xf0;
-	MachineState.Memory[0x70 + 1] = 0x10;
-	MachineState.Memory[0x70 + 2] = 0x20;
-	MachineState.Memory[0x70 + 3] = 0x40;
-	MachineState.Memory[0x70 + 4] = 0x40;
-
-	/*
-	####
-	#  #
-	####
-	#  #
-	####
-	*/
-	MachineState.Memory[0x80] = 0xf0;
-	MachineState.Memory[0x80 + 1] = 0x90;
-	MachineState.Memory[0x80 + 2] = 0xf0;
-	MachineState.Memory[0x80 + 3] = 0x90;
-	MachineState.Memory[0x80 + 4] = 0xf0;
+	if (gdbAddress != NULL && gdbOpen(&Gdb, gdbAddress) != 0) {
+		printf("Could not listen on %s\n", gdbAddress);
+		return 1;
+	}
 
-	/*
-	####
-	#  #
-	####
-	   #
-	####
-	*/
-	MachineState.Memory[0x90] = 0xf0;
-	MachineState.Memory[0x90 + 1] = 0x90;
-	MachineState.Memory[0x90 + 2] = 0xf0;
-	MachineState.Memory[0x90 + 3] = 0x10;
-	MachineState.Memory[0x90 + 4] = 0xf0;
+	if (metricsTarget != NULL && metricsStart(&Counters, metricsTarget, metricsInterval) != 0) {
+		printf("Could not report metrics to %s\n", metricsTarget);
+		return 1;
+	}
 
-	/*
-	####
-	#  #
-	####
-	#  #
-	#  #
-	*/
-	MachineState.Memory[0xa0] = 0xf0;
-	MachineState.Memory[0xa0 + 1] = 0x90;
-	MachineState.Memory[0xa0 + 2] = 0xa0;
-	MachineState.Memory[0xa0 + 3] = 0x90;
-	MachineState.Memory[0xa0 + 4] = 0x90;
+	if (sharedName != NULL) {
+		Exported = sharedFrameCreate(sharedName);
+		if (Exported == NULL) {
+			printf("Could not create shared memory %s\n", sharedName);
+			return 1;
+		}
+	}
 
 	/*
-	###
-	#  #
-	###
-	#  #
-	###
+	Headless runs skip the window and the emulation thread and only produce audio and images.
+	Frames are written as they are run so a run of any length takes the same memory.
 	*/
-	MachineState.Memory[0xb0] = 0xe0;
-	MachineState.Memory[0xb0 + 1] = 0x90;
-	MachineState.Memory[0xb0 + 2] = 0xe0;
-	MachineState.Memory[0xb0 + 3] = 0x90;
-	MachineState.Memory[0xb0 + 4] = 0xe0;
+	if (headlessFrames >= 0) {
+		unsigned char pixels[IMAGE_WIDTH * IMAGE_HEIGHT];
 
-	/*
-	####
-	#
-	#
-	#
-	####
-	*/
-	MachineState.Memory[0xc0] = 0xf0;
-	MachineState.Memory[0xc0 + 1] = 0x80;
-	MachineState.Memory[0xc0 + 2] = 0x80;
-	MachineState.Memory[0xc0 + 3] = 0x80;
-	MachineState.Memory[0xc0 + 4] = 0xf0;
-	
-	/*
-	###
-	#  #
-	#  #
-	#  #
-	###
-	*/
-	MachineState.Memory[0xd0] = 0xe0;
-	MachineState.Memory[0xd0 + 1] = 0x90;
-	MachineState.Memory[0xd0 + 2] = 0x90;
-	MachineState.Memory[0xd0 + 3] = 0x90;
-	MachineState.Memory[0xd0 + 4] = 0xe0;
+		for (long frame = 0; frame < headlessFrames && status == -1; frame++) {
+			const Display *display;
+			int expanded = 0;
+			int isHigh;
+			unsigned long long started;
 
-	/*
-	####
-	#
-	####
-	#
-	####
-	*/
-	MachineState.Memory[0xe0] = 0xf0;
-	MachineState.Memory[0xe0 + 1] = 0x80;
-	MachineState.Memory[0xe0 + 2] = 0xf0;
-	MachineState.Memory[0xe0 + 3] = 0x80;
-	MachineState.Memory[0xe0 + 4] = 0xf0;
+			gdbPoll(&Gdb, Machine);
+			started = metricsNow();
+			status = runFrame(&ToneAudio);
+			countFrame(metricsNow() - started);
 
-	/*
-	####
-	#
-	####
-	#
-	#
-	*/
-	MachineState.Memory[0xf0] = 0xf0;
-	MachineState.Memory[0xf0 + 1] = 0x80;
-	MachineState.Memory[0xf0 + 2] = 0xf0;
-	MachineState.Memory[0xf0 + 3] = 0x80;
-	MachineState.Memory[0xf0 + 4] = 0x80;
+			display = chip8Framebuffer(Machine, &isHigh);
+			display = persistenceApply(&Phosphor, display, isHigh);
 
-	/*
-	Load program into memory
-	*/
+			if (Exported != NULL) {
+				sharedFramePublish(Exported, display, isHigh, frame + 1, Machine->Keys);
+			}
 
-	FILE *programFile = fopen(argv[1], "rb");
+			if (wav != NULL && drainTone(&ToneAudio, wav) != 0) {
+				printf("Could not write %s\n", wavPath);
+				return 1;
+			}
 
-	fread(MachineState.Memory + 0x200, sizeof(unsigned char), 0x1000 - 0x200, programFile);
+			if (video != NULL) {
+				expandDisplay(display, isHigh, pixels);
+				expanded = 1;
 
-	fclose(programFile);
+				if (y4mWrite(video, pixels) != 0) {
+					printf("Could not write %s\n", videoPath);
+					return 1;
+				}
+			}
 
-	int screenWidth = 1920;
-	int screenHeight = 1080;
+			for (int i = 0; i < pngCount; i++) {
+				if (pngFrames[i] != frame) {
+					continue;
+				}
 
-	InitWindow(screenWidth, screenHeight, "Chip8 Emulator");
+				if (!expanded) {
+					expandDisplay(display, isHigh, pixels);
+					expanded = 1;
+				}
 
-	SetTargetFPS(60);
+				if (pngWrite(pngPaths[i], pixels) != 0) {
+					printf("Could not write %s\n", pngPaths[i]);
+					return 1;
+				}
+			}
+		}
+	} else {
+		Viewport viewport;
+		AudioStream stream;
+		pthread_t emulationThread;
 
-	while (!IsWindowReady()) {
-		
-	}
+		SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+		InitWindow(1920, 1080, "Chip8 Emulator");
 
-	while (!WindowShouldClose()) {
-		if (IsWindowResized()) {
-			screenWidth = GetScreenWidth();
-			screenHeight = GetScreenHeight();
+		while (!IsWindowReady()) {
+			
 		}
-		/*
-		Handle Input
-		*/
-		
-		/*
-		Clear Keys
-		*/
-		MachineState.Keys = 0;
-		
-		/*
-		Key 0
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_ONE) << 0;
 
-		/*
-		Key 1
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_TWO) << 1;
+		Image image = { DisplayPixels, IMAGE_WIDTH, IMAGE_HEIGHT, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
 
-		/*
-		Key 2
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_THREE) << 2;
+		DisplayTexture = LoadTextureFromImage(image);
+		viewportInit(&viewport, IMAGE_WIDTH, IMAGE_HEIGHT, GetScreenWidth(), GetScreenHeight());
 
-		/*
-		Key 3
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_FOUR) << 3;
+		if (wav == NULL) {
+			InitAudioDevice();
+			SetAudioStreamBufferSizeDefault(bufferFrames);
+			stream = LoadAudioStream(sampleRate, 16, 1);
+			SetAudioStreamCallback(stream, playTone);
+			PlayAudioStream(stream);
+		}
 
-		/*
-		Key 4
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_Q) << 4;
+		frameTripleInit(&Frames);
+		Gdb.Quit = &RenderDone;
 
-		/*
-		Key 5
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_W) << 5;
+		if (pthread_create(&emulationThread, NULL, emulate, wav) != 0) {
+			printf("Could not start the emulation thread\n");
+			return 1;
+		}
 
-		/*
-		Key 6
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_E) << 6;
-		
-		/*
-		Key 7
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_R) << 7;
+		unsigned long shownFrame = 0;
+		unsigned long long renderPeriod = 1000000000 / 60;
+		unsigned long long renderDeadline = metricsNow();
 
-		/*
-		Key 8
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_A) << 8;
-	
-		/*
-		Key 9
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_S) << 9;
+		while (!WindowShouldClose() && !__atomic_load_n(&EmulationDone, __ATOMIC_ACQUIRE)) {
+			const Frame *frame;
+			unsigned long long started;
+			unsigned long long now;
 
-		/*
-		Key a
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_D) << 10;
+			if (IsWindowResized()) {
+				viewportResize(&viewport, GetScreenWidth(), GetScreenHeight());
+			}
+			/*
+			Handle Input
+			*/
+			__atomic_store_n(&SharedKeys, readKeys(), __ATOMIC_RELAXED);
 
-		/*
-		Key b
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_F) << 11;
+			started = metricsNow();
+			frame = frameTripleFront(&Frames);
 
-		/*
-		Key c
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_Z) << 12;
+			BeginDrawing();
 
-		/*
-		Key d
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_X) << 13;
+			ClearBackground(BLACK);
 
-		/*
-		Key e
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_C) << 14;
+			drawDisplayBuffer(frame, &viewport);
 
-		/*
-		Key f
-		*/
-		MachineState.Keys |= (unsigned short)IsKeyDown(KEY_V) << 15;
+			EndDrawing();
 
-		/*
-		Set KeyMask for released keys
-		*/
-		MachineState.KeyMask |= ~(MachineState.Keys);	
+			metricsAdd(&Counters.Render.RenderNanoseconds, metricsNow() - started);
 
-		/*
-		Do N ticks
-		*/
-		int ticksPerFrame = 10;
-
-		for (int i = 0; i < ticksPerFrame; i++) {
-			unsigned short opcode = (MachineState.Memory[MachineState.ProgramCounter] << 8) | MachineState.Memory[MachineState.ProgramCounter + 1];		
-			#ifdef DEBUG
-			printf("Opcode: %X\n", opcode);
-			for (int j = 0; j < 15; j++) {
-				printf("v%i: %X\n", j, MachineState.V[j]);
-			}	
-			printf("Keys: %X\n", MachineState.Keys);
-			printf("DisplayBuffer:\n");
-			if (MachineState.DisplayIsHigh) {
-				for (int i = 0; i < 64; i++) {
-					printf("%llX %llX\n", MachineState.DisplayBuffer.High[0][i], MachineState.DisplayBuffer.High[1][i]);
-				}
-			} else {
-				for (int i = 0; i < 32; i++) {
-					printf("%llX\n", MachineState.DisplayBuffer.Low[i]);
-				}
-			}
-			getchar();
-			getchar();
-			#endif
 			/*
-			Match opcode to function
-			This could be made faster with a prefix tree
+			Frame 0 is the empty slot from before anything was published, and the front frame is drawn again until a newer one is.
 			*/
-			switch (opcode & 0xF000) {
-			case 0x0000:
-				switch (opcode & 0xF00) {
-				case 0x000:
-					switch (opcode & 0xF0) {
-					case 0x10:
-						/*
-						0x001X
-						*/
-						return programExitValue(opcode & 0xF);
-						break;
-					case 0xC0:
-						/*
-						0x00C0
-						*/
-						scrollDownN(opcode & 0xF);
-						break;
-					case 0xE0:
-						switch (opcode & 0xF) {
-						case 0x0:
-							/*
-							0x00E0
-							*/
-							clearScreen();
-							break;
-						case 0xE:
-							/*
-							0x00EE
-							*/
-							subroutineReturn();
-							break;
-						}
-						break;
-					case 0xF0:
-						switch (opcode & 0xF) {
-						case 0xA:
-							/*
-							0x00FA
-							*/
-							compatability();
-							break;
-						case 0xB:
-							/*
-							0x00FB
-							*/
-							scrollRight();
-							break;
-						case 0xC:
-							/*
-							0x00FC
-							*/
-							scrollLeft();
-							break;
-						case 0xD:
-							/*
-							0x00FD
-							*/
-							return programExit();
-						case 0xE:
-							/*
-							0x00FE
-							*/
-							displayBufferLow();
-							break;
-						case 0xF:
-							/*
-							0x00FF
-							*/
-							displayBufferHigh();
-							break;
-						}
-						break;
-					}
-					break;
-				default:
-					jump(opcode & 0xFFF);	
-					break;
-				}
-				break;
-			case 0x1000:
-				/*
-				0x1NNN
-				*/
-				call(opcode & 0xFFF);
-				break;
-			case 0x3000:
-				switch (opcode & 0xF) {
-				case 0x0:
-					/*
-					0x3XY0
-					*/
-					skipEqvXvY((opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
-					break;
-				default:
-					/*
-					0x3XYY
-					*/
-					skipEqvXValue((opcode & 0xF00) >> 8, opcode & 0xFF);
-					break;
-				}
-				break;
-			case 0x4000:
-				/*
-				0x4XKK
-				*/
-				skipNevXValue((opcode & 0xF00) >> 8, opcode & 0xFF);
-				break;
-			case 0x6000:
-				/*
-				0x6XKK
-				*/
-				loadvXValue((opcode & 0xF00) >> 8, opcode & 0xFF);
-				break;
-			case 0x7000:
-				/*
-				0x7XKK
-				*/
-				addvXValue((opcode & 0xF00) >> 8, opcode & 0xFF);
-				break;
-			case 0x8000:
-				switch (opcode & 0xF) {
-				case 0x0:
-					/*
-					0x8XY0
-					*/
-					loadvXvY((opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
-					break;
-				case 0x1:
-					/*
-					0x8XY1
-					*/
-					orvXvY((opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
-					break;
-				case 0x2:
-					/*
-					0x8XY2
-					*/
-					andvXvY((opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
-					break;
-				case 0x3:
-					/*
-					0x8XY3
-					*/
-					xorvXvY((opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
-					break;
-				case 0x4:
-					/*
-					0x8XY4
-					*/
-					addvXvY((opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
-					break;
-				case 0x5:
-					/*
-					0x8XY5
-					*/
-					subvXvY((opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
-					break;
-				case 0x6:
-					/*
-					0x8X06
-					*/
-					shrvX((opcode & 0xF00) >> 8);
-					break;
-				case 0x7:
-					/*
-					0x8XY7
-					*/
-					difvXvY((opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
-					break;
-				case 0xE:
-					/*
-					0x8X0E
-					*/
-					shlvX((opcode & 0xF00) >> 8);
-					break;
-				}
-				break;
-			case 0x9000:
-				/*
-				0x9XY0
-				*/
-				skipNevXvY((opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
-				break;
-			case 0xA000:
-				/*
-				0xANNN
-				*/
-				loadI(opcode & 0xFFF);
-				break;
-			case 0xB000:
-				/*
-				0xBNNN
-				*/
-				jumpv0(opcode & 0xFFF);
-				break;
-			case 0xC000:
-				/*
-				0xCXKK
-				*/
-				rndvXMask((opcode & 0xF00) >> 8, opcode & 0xFF);
-				break;
-			case 0xD000:
-				switch (opcode & 0xF) {
-
-				case 0x0:
-					/*
-					0xDXY0
-					*/
-					#ifdef DEBUG
-					printf("draw %X, %X\n", (opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
-					#endif
-
-					drawvXvY((opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4);
-					break;
-				default:
-					/*
-					0xDXYN
-					*/
-					drawvXvYRows((opcode & 0xF00) >> 8, (opcode & 0xF0) >> 4, opcode & 0xF);
-					break;
-				}
-			case 0xE000:
-				switch (opcode & 0xFF) {
-				case 0x9E:
-					/*
-					0xEX9E
-					*/
-					skipvXKey((opcode & 0xF00) >> 8);
-					break;
-				case 0xA1:
-					/*
-					0xEXA1
-					*/
-					skipNevXKey((opcode & 0xF00) >> 8);
-					break;
-				}
-				break;
-			case 0xF000:
-				switch (opcode & 0xFF) {
-				case 0x07:
-					/*
-					0xFX07
-					*/
-					loadvXTime((opcode & 0xF00) >> 8);
-					break;
-				case 0x0A:
-					/*
-					0xFX0A
-					*/
-					loadvXKey((opcode & 0xF00) >> 8);
-					break;
-				case 0x15:
-					/*
-					0xFX15
-					*/
-					loadTimevX((opcode & 0xF00) >> 8);
-					break;
-				case 0x18:
-					/*
-					0xFX18
-					*/
-					loadTonevX((opcode & 0xF00) >> 8);
-					break;
-				case 0x1E:
-					/*
-					0xFX1E
-					*/
-					addIvX((opcode & 0xF00) >> 8);
-					break;
-				case 0x29:
-					/*
-					0xFX29
-					*/
-					hexvX((opcode & 0xF00) >> 8);
-					break;
-				case 0x33:
-					/*
-					0xFX33
-					*/
-					bcdvX((opcode & 0xF00) >> 8);
-					break;
-				case 0x55:
-					/*
-					0xFX55
-					*/
-					savevX((opcode & 0xF00) >> 8);
-					break;
-				case 0x65:
-					/*
-					0xFX65
-					*/
-					restorevX((opcode & 0xF00) >> 8);
-					break;
-				}
-				break;
-			}
-			
-			if (!MachineState.WaitingForKeyPress) {
-				MachineState.ProgramCounter += 2;
-			}
-		}		
-		
-		/*
-		Handle Time and Tone registers
-		*/
-		if (!MachineState.WaitingForKeyPress) {
-			if (MachineState.Time > 0) {
-				MachineState.Time -= 1;
+			if (frame->Number > shownFrame) {
+				metricsAdd(&Counters.Render.Rendered, 1);
+				metricsAdd(&Counters.Render.Dropped, frame->Number - shownFrame - 1);
+				shownFrame = frame->Number;
 			}
 
-			if (MachineState.Tone > 0) {
-				/*
-				TODO
-				Play Tone
-				*/
-				MachineState.Tone -= 1;
+			/*
+			The loop is paced here rather than with SetTargetFPS, so the wait stays out of the render time.
+			Like the emulation thread it starts again from now when it falls more than a frame behind.
+			*/
+			renderDeadline += renderPeriod;
+			now = metricsNow();
+			if (now > renderDeadline + renderPeriod) {
+				renderDeadline = now;
+			} else if (now < renderDeadline) {
+				struct timespec wait = { (renderDeadline - now) / 1000000000, (renderDeadline - now) % 1000000000 };
+
+				nanosleep(&wait, NULL);
 			}
 		}
 
-		BeginDrawing();
+		__atomic_store_n(&RenderDone, 1, __ATOMIC_RELEASE);
+		pthread_join(emulationThread, NULL);
+		status = EmulationStatus;
 
-		ClearBackground(BLACK);
-		
-		/*
-		Draw DisplayBuffer
-		*/	
-		if (MachineState.DisplayIsHigh) {
-			int pixelWidth = screenWidth / 128;
-			int pixelHeight = screenWidth / 64;
-
-			for (int y = 0; y < 64; y++) {
-				for (int x = 0; x < 64; x++) {
-					if (MachineState.DisplayBuffer.High[0][y] & ((unsigned long long)1 << (63 - x))) {
-						DrawRectangle(x * pixelWidth, y * pixelHeight, pixelWidth, pixelHeight, WHITE);	
-					}
-
-					if (MachineState.DisplayBuffer.High[1][y] & ((unsigned long long)1 << (63 - x))) {
-						DrawRectangle(x * pixelWidth + pixelWidth * 64, y * pixelHeight, pixelWidth, pixelHeight, WHITE);	
-					}
-				}
-			}
-		} else {
-			int pixelWidth = screenWidth / 64;
-			int pixelHeight = screenHeight/ 32;
-			
-			for (int y = 0; y < 32; y++) {
-				for (int x = 0; x < 64; x++) {
-					if (MachineState.DisplayBuffer.Low[y] & ((unsigned long long)1 << (63 - x))) {
-						DrawRectangle(x * pixelWidth, y * pixelHeight, pixelWidth, pixelHeight, WHITE);
-					}
-				}
-			}
+		if (wav == NULL) {
+			UnloadAudioStream(stream);
+			CloseAudioDevice();
 		}
 
-		EndDrawing();
+		UnloadTexture(DisplayTexture);
+		CloseWindow();
 	}
-	return 0;
+
+	if (metricsTarget != NULL) {
+		metricsStop(&Counters);
+	}
+
+	if (Exported != NULL) {
+		sharedFrameClose(Exported, sharedName);
+	}
+
+	if (status != -1) {
+		gdbExited(&Gdb, status);
+	}
+	gdbClose(&Gdb);
+
+	if (wav != NULL && wavClose(wav) != 0) {
+		printf("Could not write %s\n", wavPath);
+		return 1;
+	}
+
+	if (video != NULL && fclose(video) != 0) {
+		printf("Could not write %s\n", videoPath);
+		return 1;
+	}
+
+	toneFree(&ToneAudio);
+	chip8Destroy(Machine);
+
+	return status == -1 ? 0 : status;
 }
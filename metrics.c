@@ -0,0 +1,242 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+
+/*
+How often the reporter checks for the stop flag, in milliseconds.
+*/
+#define REPORT_STEP 50
+
+/*
+Function Declarations
+*/
+
+static unsigned long long
+readCounter(const unsigned long long *counter);
+
+static int
+formatReport(Metrics *metrics, char *line, size_t size, double elapsed, unsigned long long *lastInstructions, double *lastElapsed);
+
+static void
+writeReport(Metrics *metrics, const char *line);
+
+static void
+serveReport(Metrics *metrics, const char *line, long milliseconds);
+
+static void *
+report(void *argument);
+
+/*
+Function Definitions
+*/
+
+void
+metricsSet(unsigned long long *counter, unsigned long long value)
+{
+	__atomic_store_n(counter, value, __ATOMIC_RELAXED);
+}
+
+void
+metricsAdd(unsigned long long *counter, unsigned long long amount)
+{
+	/*
+	Only the owning thread writes the counter, so a load and a store do without a locked add.
+	*/
+	__atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + amount, __ATOMIC_RELAXED);
+}
+
+unsigned long long
+metricsNow(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (unsigned long long)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static unsigned long long
+readCounter(const unsigned long long *counter)
+{
+	return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/*
+Writes the counters as one JSON line, with the instructions per second since the last line.
+*/
+static int
+formatReport(Metrics *metrics, char *line, size_t size, double elapsed, unsigned long long *lastInstructions, double *lastElapsed)
+{
+	unsigned long long instructions = readCounter(&metrics->Emulation.Instructions);
+	double ips = elapsed > *lastElapsed ? (instructions - *lastInstructions) / (elapsed - *lastElapsed) : 0;
+
+	*lastInstructions = instructions;
+	*lastElapsed = elapsed;
+
+	return snprintf(line, size,
+		"{\"seconds\":%.3f,\"instructions\":%llu,\"ips\":%.0f,\"frames\":%llu,\"rendered\":%llu,\"dropped\":%llu,\"late\":%llu,"
+		"\"emulateSeconds\":%.6f,\"renderSeconds\":%.6f,\"keyWaitFrames\":%llu,\"draws\":%llu,\"collisions\":%llu}\n",
+		elapsed, instructions, ips,
+		readCounter(&metrics->Emulation.Frames),
+		readCounter(&metrics->Render.Rendered),
+		readCounter(&metrics->Render.Dropped),
+		readCounter(&metrics->Emulation.Late),
+		readCounter(&metrics->Emulation.EmulateNanoseconds) / 1e9,
+		readCounter(&metrics->Render.RenderNanoseconds) / 1e9,
+		readCounter(&metrics->Emulation.KeyWaitFrames),
+		readCounter(&metrics->Emulation.Draws),
+		readCounter(&metrics->Emulation.Collisions));
+}
+
+/*
+Prints line, or replaces the stats file with it so readers never see half a report.
+*/
+static void
+writeReport(Metrics *metrics, const char *line)
+{
+	char temporary[4096];
+	FILE *file;
+
+	if (metrics->Path == NULL) {
+		fputs(line, stdout);
+		fflush(stdout);
+		return;
+	}
+
+	snprintf(temporary, sizeof(temporary), "%s.tmp", metrics->Path);
+	file = fopen(temporary, "w");
+	if (file == NULL) {
+		return;
+	}
+	fputs(line, file);
+	if (fclose(file) == 0) {
+		rename(temporary, metrics->Path);
+	}
+}
+
+/*
+Hands line to every client that connects in the next milliseconds.
+*/
+static void
+serveReport(Metrics *metrics, const char *line, long milliseconds)
+{
+	unsigned long long end = metricsNow() + milliseconds * 1000000ULL;
+
+	while (!__atomic_load_n(&metrics->Stop, __ATOMIC_ACQUIRE)) {
+		unsigned long long now = metricsNow();
+		long wait = now < end ? (long)((end - now) / 1000000) : 0;
+		struct pollfd ready = { metrics->Listener, POLLIN, 0 };
+
+		if (wait > REPORT_STEP) {
+			wait = REPORT_STEP;
+		}
+
+		if (poll(&ready, 1, wait) > 0) {
+			int client = accept(metrics->Listener, NULL, NULL);
+
+			if (client != -1) {
+				send(client, line, strlen(line), MSG_NOSIGNAL);
+				close(client);
+			}
+		} else if (now >= end) {
+			return;
+		}
+	}
+}
+
+/*
+Reporter thread.
+*/
+static void *
+report(void *argument)
+{
+	Metrics *metrics = argument;
+	unsigned long long start = metricsNow();
+	unsigned long long lastInstructions = 0;
+	double lastElapsed = 0;
+	char line[512];
+
+	formatReport(metrics, line, sizeof(line), 0, &lastInstructions, &lastElapsed);
+
+	while (!__atomic_load_n(&metrics->Stop, __ATOMIC_ACQUIRE)) {
+		if (metrics->Listener != -1) {
+			serveReport(metrics, line, metrics->IntervalMilliseconds);
+		} else {
+			for (long waited = 0; waited < metrics->IntervalMilliseconds && !__atomic_load_n(&metrics->Stop, __ATOMIC_ACQUIRE); waited += REPORT_STEP) {
+				struct timespec step = { 0, REPORT_STEP * 1000000L };
+
+				nanosleep(&step, NULL);
+			}
+		}
+
+		formatReport(metrics, line, sizeof(line), (metricsNow() - start) / 1e9, &lastInstructions, &lastElapsed);
+		if (metrics->Listener == -1) {
+			writeReport(metrics, line);
+		}
+	}
+
+	return NULL;
+}
+
+int
+metricsStart(Metrics *metrics, const char *target, double interval)
+{
+	memset(metrics, 0, sizeof(*metrics));
+	metrics->Listener = -1;
+	metrics->IntervalMilliseconds = interval * 1000;
+	if (metrics->IntervalMilliseconds < REPORT_STEP) {
+		metrics->IntervalMilliseconds = REPORT_STEP;
+	}
+
+	if (strncmp(target, "unix:", 5) == 0) {
+		struct sockaddr_un name = { 0 };
+
+		if (strlen(target + 5) >= sizeof(name.sun_path)) {
+			return -1;
+		}
+		name.sun_family = AF_UNIX;
+		strcpy(name.sun_path, target + 5);
+		unlink(name.sun_path);
+
+		metrics->Listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (metrics->Listener == -1) {
+			return -1;
+		}
+		if (bind(metrics->Listener, (struct sockaddr *)&name, sizeof(name)) != 0 || listen(metrics->Listener, 4) != 0) {
+			close(metrics->Listener);
+			return -1;
+		}
+	} else if (strcmp(target, "-") != 0) {
+		metrics->Path = target;
+	}
+
+	if (pthread_create(&metrics->Reporter, NULL, report, metrics) != 0) {
+		if (metrics->Listener != -1) {
+			close(metrics->Listener);
+		}
+		return -1;
+	}
+
+	return 0;
+}
+
+void
+metricsStop(Metrics *metrics)
+{
+	__atomic_store_n(&metrics->Stop, 1, __ATOMIC_RELEASE);
+	pthread_join(metrics->Reporter, NULL);
+
+	if (metrics->Listener != -1) {
+		close(metrics->Listener);
+	}
+}
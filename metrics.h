@@ -0,0 +1,96 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Runtime counters of a long running emulator.
+Each thread owns its counters and stores them once a frame, a reporter thread reads them at an interval and writes one JSON line.
+Lines go to standard output, replace a stats file, or are handed to every client that connects to a Unix socket.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <pthread.h>
+
+/*
+Type Declarations
+*/
+
+/*
+Written by the thread running the machine.
+*/
+typedef struct {
+	unsigned long long Instructions;
+	unsigned long long Draws;
+	unsigned long long Collisions;
+	unsigned long long Frames;
+	/*
+	Frames the emulation fell so far behind on that it started again from now.
+	*/
+	unsigned long long Late;
+	unsigned long long KeyWaitFrames;
+	unsigned long long EmulateNanoseconds;
+} EmulationMetrics;
+
+/*
+Written by the render thread.
+*/
+typedef struct {
+	unsigned long long Rendered;
+	/*
+	Frames published that were replaced before they were drawn.
+	*/
+	unsigned long long Dropped;
+	unsigned long long RenderNanoseconds;
+} RenderMetrics;
+
+typedef struct {
+	EmulationMetrics Emulation;
+	RenderMetrics Render;
+	/*
+	Owned by the reporter thread.
+	*/
+	pthread_t Reporter;
+	int Stop;
+	long IntervalMilliseconds;
+	const char *Path;
+	int Listener;
+} Metrics;
+
+/*
+Function Declarations
+*/
+
+/*
+Stores value into a counter owned by the calling thread so the reporter can read it.
+*/
+void
+metricsSet(unsigned long long *counter, unsigned long long value);
+
+/*
+Adds amount to a counter owned by the calling thread.
+*/
+void
+metricsAdd(unsigned long long *counter, unsigned long long amount);
+
+/*
+Returns a monotonic time in nanoseconds for timing sections.
+*/
+unsigned long long
+metricsNow(void);
+
+/*
+Starts reporting every interval seconds to target: "-" for standard output, "unix:path" for a Unix socket, else a file path.
+Returns 0 on success, -1 if the target could not be opened or the thread not started.
+*/
+int
+metricsStart(Metrics *metrics, const char *target, double interval);
+
+/*
+Writes a last report and stops the reporter.
+*/
+void
+metricsStop(Metrics *metrics);
+
+#endif
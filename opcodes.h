@@ -0,0 +1,96 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+The one description of every opcode, shared by the disassembler, the assembler and the table dispatched interpreter.
+Nothing but macros, so chip8.c can use it and still be built on its own.
+*/
+
+#ifndef OPCODES_H
+#define OPCODES_H
+
+/*
+Operand kinds.
+*/
+enum {
+	OPERAND_NONE,
+	/*
+	Registers from the X and Y nibbles.
+	*/
+	OPERAND_VX,
+	OPERAND_VY,
+	/*
+	Numbers from the low byte, the low 12 bits and the low nibble.
+	*/
+	OPERAND_BYTE,
+	OPERAND_ADDRESS,
+	OPERAND_NIBBLE,
+	/*
+	Words that are always the same.
+	*/
+	OPERAND_V0,
+	OPERAND_I,
+	OPERAND_KEY,
+	OPERAND_TIME,
+	OPERAND_TONE
+};
+
+#define OPCODE_OPERANDS 3
+
+/*
+OPCODES(X) expands X(mask, match, handler, mnemonic, operand, operand, operand) for every opcode, in the order the interpreter decodes them, the first match wins.
+An opcode matches when (opcode & mask) == match.
+handler is the function chip8.c runs it with.
+A NULL mnemonic marks opcodes the interpreter does nothing for, which are shown as data.
+Draws fall through into the key skips, so a draw ending in 9E or A1 also skips on a key.
+*/
+#define OPCODES(X) \
+	X(0xFFF0, 0x0010, opExitValue, "exit", OPERAND_NIBBLE, OPERAND_NONE, OPERAND_NONE) \
+	X(0xFFF0, 0x00C0, opScrollDown, "scdown", OPERAND_NIBBLE, OPERAND_NONE, OPERAND_NONE) \
+	X(0xFFFF, 0x00E0, opClear, "clear", OPERAND_NONE, OPERAND_NONE, OPERAND_NONE) \
+	X(0xFFFF, 0x00EE, opReturn, "ret", OPERAND_NONE, OPERAND_NONE, OPERAND_NONE) \
+	X(0xFFFF, 0x00FA, opCompatability, "compatability", OPERAND_NONE, OPERAND_NONE, OPERAND_NONE) \
+	X(0xFFFF, 0x00FB, opScrollRight, "scright", OPERAND_NONE, OPERAND_NONE, OPERAND_NONE) \
+	X(0xFFFF, 0x00FC, opScrollLeft, "scleft", OPERAND_NONE, OPERAND_NONE, OPERAND_NONE) \
+	X(0xFFFF, 0x00FD, opExit, "exit", OPERAND_NONE, OPERAND_NONE, OPERAND_NONE) \
+	X(0xFFFF, 0x00FE, opLow, "low", OPERAND_NONE, OPERAND_NONE, OPERAND_NONE) \
+	X(0xFFFF, 0x00FF, opHigh, "high", OPERAND_NONE, OPERAND_NONE, OPERAND_NONE) \
+	X(0xFF00, 0x0000, opNone, NULL, OPERAND_NONE, OPERAND_NONE, OPERAND_NONE) \
+	X(0xF000, 0x0000, opJump, "jump", OPERAND_ADDRESS, OPERAND_NONE, OPERAND_NONE) \
+	X(0xF000, 0x1000, opCall, "call", OPERAND_ADDRESS, OPERAND_NONE, OPERAND_NONE) \
+	X(0xF00F, 0x3000, opSkipEqvXvY, "skip.eq", OPERAND_VX, OPERAND_VY, OPERAND_NONE) \
+	X(0xF000, 0x3000, opSkipEqvXValue, "skip.eq", OPERAND_VX, OPERAND_BYTE, OPERAND_NONE) \
+	X(0xF000, 0x4000, opSkipNevXValue, "skip.ne", OPERAND_VX, OPERAND_BYTE, OPERAND_NONE) \
+	X(0xF000, 0x6000, opLoadvXValue, "load", OPERAND_VX, OPERAND_BYTE, OPERAND_NONE) \
+	X(0xF000, 0x7000, opAddvXValue, "add", OPERAND_VX, OPERAND_BYTE, OPERAND_NONE) \
+	X(0xF00F, 0x8000, opLoadvXvY, "load", OPERAND_VX, OPERAND_VY, OPERAND_NONE) \
+	X(0xF00F, 0x8001, opOrvXvY, "or", OPERAND_VX, OPERAND_VY, OPERAND_NONE) \
+	X(0xF00F, 0x8002, opAndvXvY, "and", OPERAND_VX, OPERAND_VY, OPERAND_NONE) \
+	X(0xF00F, 0x8003, opXorvXvY, "xor", OPERAND_VX, OPERAND_VY, OPERAND_NONE) \
+	X(0xF00F, 0x8004, opAddvXvY, "add", OPERAND_VX, OPERAND_VY, OPERAND_NONE) \
+	X(0xF00F, 0x8005, opSubvXvY, "sub", OPERAND_VX, OPERAND_VY, OPERAND_NONE) \
+	X(0xF00F, 0x8006, opShrvX, "shr", OPERAND_VX, OPERAND_VY, OPERAND_NONE) \
+	X(0xF00F, 0x8007, opDifvXvY, "dif", OPERAND_VX, OPERAND_VY, OPERAND_NONE) \
+	X(0xF00F, 0x800E, opShlvX, "shl", OPERAND_VX, OPERAND_VY, OPERAND_NONE) \
+	X(0xF000, 0x9000, opSkipNevXvY, "skip.ne", OPERAND_VX, OPERAND_VY, OPERAND_NONE) \
+	X(0xF000, 0xA000, opLoadI, "load", OPERAND_I, OPERAND_ADDRESS, OPERAND_NONE) \
+	X(0xF000, 0xB000, opJumpv0, "jump", OPERAND_ADDRESS, OPERAND_V0, OPERAND_NONE) \
+	X(0xF000, 0xC000, opRndvXMask, "rnd", OPERAND_VX, OPERAND_BYTE, OPERAND_NONE) \
+	X(0xF00F, 0xD000, opXdrawvXvY, "xdraw", OPERAND_VX, OPERAND_VY, OPERAND_NONE) \
+	X(0xF0FF, 0xD09E, opDrawSkipvXKey, "draw", OPERAND_VX, OPERAND_VY, OPERAND_NIBBLE) \
+	X(0xF0FF, 0xD0A1, opDrawSkipNevXKey, "draw", OPERAND_VX, OPERAND_VY, OPERAND_NIBBLE) \
+	X(0xF000, 0xD000, opDrawvXvY, "draw", OPERAND_VX, OPERAND_VY, OPERAND_NIBBLE) \
+	X(0xF0FF, 0xE09E, opSkipvXKey, "skip.eq", OPERAND_VX, OPERAND_KEY, OPERAND_NONE) \
+	X(0xF0FF, 0xE0A1, opSkipNevXKey, "skip.ne", OPERAND_VX, OPERAND_KEY, OPERAND_NONE) \
+	X(0xF0FF, 0xF007, opLoadvXTime, "load", OPERAND_VX, OPERAND_TIME, OPERAND_NONE) \
+	X(0xF0FF, 0xF00A, opLoadvXKey, "load", OPERAND_VX, OPERAND_KEY, OPERAND_NONE) \
+	X(0xF0FF, 0xF015, opLoadTimevX, "load", OPERAND_TIME, OPERAND_VX, OPERAND_NONE) \
+	X(0xF0FF, 0xF018, opLoadTonevX, "load", OPERAND_TONE, OPERAND_VX, OPERAND_NONE) \
+	X(0xF0FF, 0xF01E, opAddIvX, "add", OPERAND_I, OPERAND_VX, OPERAND_NONE) \
+	X(0xF0FF, 0xF029, opHexvX, "hex", OPERAND_VX, OPERAND_NONE, OPERAND_NONE) \
+	X(0xF0FF, 0xF033, opBcdvX, "bcd", OPERAND_VX, OPERAND_NONE, OPERAND_NONE) \
+	X(0xF0FF, 0xF055, opSavevX, "save", OPERAND_VX, OPERAND_NONE, OPERAND_NONE) \
+	X(0xF0FF, 0xF065, opRestorevX, "restore", OPERAND_VX, OPERAND_NONE, OPERAND_NONE)
+
+#endif
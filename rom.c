@@ -0,0 +1,119 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rom.h"
+
+/*
+Function Definitions
+*/
+
+int
+romOpen(Rom *rom, const char *path)
+{
+	struct stat status;
+	void *data;
+	int fd;
+
+	rom->Data = NULL;
+	rom->Size = 0;
+	rom->Errno = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		rom->Errno = errno;
+		return ROM_SYSTEM_ERROR;
+	}
+
+	if (fstat(fd, &status) != 0) {
+		rom->Errno = errno;
+		close(fd);
+		return ROM_SYSTEM_ERROR;
+	}
+
+	if (!S_ISREG(status.st_mode)) {
+		close(fd);
+		return ROM_NOT_REGULAR;
+	}
+
+	if (status.st_size == 0) {
+		close(fd);
+		return ROM_EMPTY;
+	}
+
+	rom->Size = status.st_size;
+
+	if (status.st_size > ROM_MAX_SIZE) {
+		close(fd);
+		return ROM_TOO_LARGE;
+	}
+
+	/*
+	The mapping stays valid after the descriptor is closed.
+	*/
+	data = mmap(NULL, rom->Size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		rom->Errno = errno;
+		close(fd);
+		return ROM_SYSTEM_ERROR;
+	}
+
+	close(fd);
+
+	rom->Data = data;
+
+	return ROM_OK;
+}
+
+const char *
+romError(const Rom *rom, int error)
+{
+	static char message[64];
+
+	switch (error) {
+	case ROM_OK:
+		return "No error";
+	case ROM_SYSTEM_ERROR:
+		return strerror(rom->Errno);
+	case ROM_EMPTY:
+		return "Program is empty";
+	case ROM_TOO_LARGE:
+		snprintf(message, sizeof(message), "Program is %zu bytes, only %d fit in memory", rom->Size, ROM_MAX_SIZE);
+		return message;
+	case ROM_NOT_REGULAR:
+		return "Not a regular file";
+	}
+
+	return "Unknown error";
+}
+
+int
+romIsUnaligned(const Rom *rom)
+{
+	return rom->Size & 1;
+}
+
+void
+romLoad(const Rom *rom, unsigned char *memory)
+{
+	memcpy(memory + ROM_START, rom->Data, rom->Size);
+}
+
+void
+romClose(Rom *rom)
+{
+	if (rom->Data != NULL) {
+		munmap((void *)rom->Data, rom->Size);
+	}
+
+	rom->Data = NULL;
+	rom->Size = 0;
+}
@@ -0,0 +1,78 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Program files.
+A program is mapped read only once and can then be loaded into any number of machines without reading the file again.
+*/
+
+#ifndef ROM_H
+#define ROM_H
+
+#include <stddef.h>
+
+/*
+Programs are loaded at ROM_START and may fill the rest of memory.
+*/
+#define ROM_START 0x200
+#define ROM_MAX_SIZE (0x1000 - ROM_START)
+
+/*
+romOpen results.
+*/
+enum {
+	ROM_OK,
+	ROM_SYSTEM_ERROR,
+	ROM_EMPTY,
+	ROM_TOO_LARGE,
+	ROM_NOT_REGULAR
+};
+
+/*
+Type Declarations
+*/
+
+typedef struct {
+	const unsigned char *Data;
+	size_t Size;
+	/*
+	Set to errno when romOpen returns ROM_SYSTEM_ERROR.
+	*/
+	int Errno;
+} Rom;
+
+/*
+Function Declarations
+*/
+
+/*
+Maps the program at path read only and validates its size.
+Returns ROM_OK on success, else one of the errors above.
+*/
+int
+romOpen(Rom *rom, const char *path);
+
+/*
+Returns a message describing an error returned by romOpen.
+*/
+const char *
+romError(const Rom *rom, int error);
+
+/*
+Returns non zero if the program is an odd number of bytes long, and so ends in half an instruction.
+*/
+int
+romIsUnaligned(const Rom *rom);
+
+/*
+Copies the program into memory at ROM_START.
+memory must be 0x1000 bytes long.
+*/
+void
+romLoad(const Rom *rom, unsigned char *memory);
+
+void
+romClose(Rom *rom);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "script.h"
+
+/*
+Function Definitions
+*/
+
+int
+readScript(const char *path, Input **inputs, int *count)
+{
+	FILE *file = fopen(path, "r");
+	int capacity = 0;
+	Input input;
+	int read;
+
+	if (file == NULL) {
+		return -1;
+	}
+
+	*inputs = NULL;
+	*count = 0;
+
+	while ((read = fscanf(file, "%d %hx", &input.Frame, &input.Keys)) == 2) {
+		if (*count == capacity) {
+			Input *grown;
+
+			capacity = capacity ? capacity * 2 : 64;
+			grown = realloc(*inputs, capacity * sizeof(Input));
+			if (grown == NULL) {
+				free(*inputs);
+				fclose(file);
+				return -1;
+			}
+			*inputs = grown;
+		}
+		(*inputs)[(*count)++] = input;
+	}
+
+	/*
+	A line that does not parse would cut the input short, so anything but the end of the file is an error.
+	*/
+	if (read != EOF || ferror(file)) {
+		free(*inputs);
+		*inputs = NULL;
+		*count = 0;
+		fclose(file);
+		return -1;
+	}
+
+	fclose(file);
+	return 0;
+}
@@ -0,0 +1,36 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Scripted input for headless runs.
+*/
+
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+/*
+Type Declarations
+*/
+
+/*
+Keys held from frame Frame on.
+*/
+typedef struct {
+	int Frame;
+	unsigned short Keys;
+} Input;
+
+/*
+Function Declarations
+*/
+
+/*
+Reads a script into inputs, which the caller frees.
+The script has one line per change of input, the frame the keys are first held on and the keys as a hex mask, in order of frame.
+Returns 0 on success, -1 if the script could not be read or has a line that does not parse.
+*/
+int
+readScript(const char *path, Input **inputs, int *count);
+
+#endif
@@ -0,0 +1,120 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "shmframe.h"
+
+/*
+Function Definitions
+*/
+
+SharedFrame *
+sharedFrameCreate(const char *name)
+{
+	SharedFrame *shared;
+	int descriptor = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+
+	if (descriptor == -1) {
+		return NULL;
+	}
+
+	if (ftruncate(descriptor, sizeof(SharedFrame)) != 0) {
+		close(descriptor);
+		shm_unlink(name);
+		return NULL;
+	}
+
+	shared = mmap(NULL, sizeof(SharedFrame), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	close(descriptor);
+	if (shared == MAP_FAILED) {
+		shm_unlink(name);
+		return NULL;
+	}
+
+	shared->Version = SHARED_FRAME_VERSION;
+	__atomic_store_n(&shared->Magic, SHARED_FRAME_MAGIC, __ATOMIC_RELEASE);
+
+	return shared;
+}
+
+const SharedFrame *
+sharedFrameAttach(const char *name)
+{
+	const SharedFrame *shared;
+	int descriptor = shm_open(name, O_RDONLY, 0);
+
+	if (descriptor == -1) {
+		return NULL;
+	}
+
+	shared = mmap(NULL, sizeof(SharedFrame), PROT_READ, MAP_SHARED, descriptor, 0);
+	close(descriptor);
+	if (shared == MAP_FAILED) {
+		return NULL;
+	}
+
+	if (__atomic_load_n(&shared->Magic, __ATOMIC_ACQUIRE) != SHARED_FRAME_MAGIC || shared->Version != SHARED_FRAME_VERSION) {
+		munmap((void *)shared, sizeof(SharedFrame));
+		return NULL;
+	}
+
+	return shared;
+}
+
+void
+sharedFramePublish(SharedFrame *shared, const Display *display, int isHigh, unsigned long long frame, unsigned short keys)
+{
+	unsigned int sequence = __atomic_load_n(&shared->Sequence, __ATOMIC_RELAXED);
+
+	/*
+	The odd sequence has to be visible before any of the frame is, and the frame before the even one.
+	*/
+	__atomic_store_n(&shared->Sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	shared->IsHigh = isHigh;
+	shared->Frame = frame;
+	shared->Keys = keys;
+	memcpy(&shared->Display, display, isHigh ? sizeof(display->High) : sizeof(display->Low));
+
+	__atomic_store_n(&shared->Sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+unsigned long long
+sharedFrameRead(const SharedFrame *shared, Frame *frame, unsigned short *keys)
+{
+	unsigned int before;
+	unsigned int after;
+
+	do {
+		before = __atomic_load_n(&shared->Sequence, __ATOMIC_ACQUIRE);
+		if (before & 1) {
+			continue;
+		}
+
+		frame->IsHigh = shared->IsHigh;
+		frame->Number = shared->Frame;
+		*keys = shared->Keys;
+		memcpy(&frame->Display, &shared->Display, sizeof(frame->Display));
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&shared->Sequence, __ATOMIC_RELAXED);
+	} while ((before & 1) || before != after);
+
+	return frame->Number;
+}
+
+void
+sharedFrameClose(const SharedFrame *shared, const char *name)
+{
+	munmap((void *)shared, sizeof(SharedFrame));
+
+	if (name != NULL) {
+		shm_unlink(name);
+	}
+}
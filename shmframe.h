@@ -0,0 +1,82 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Live frames in POSIX shared memory for other processes on the same host.
+The emulator publishes every finished frame into one segment guarded by a sequence lock, readers map it and read without taking any lock.
+
+A reader loads Sequence, retries while it is odd, reads the frame, then loads Sequence again and retries if it changed.
+Every field is in host byte order, Display is laid out as in display.h.
+*/
+
+#ifndef SHMFRAME_H
+#define SHMFRAME_H
+
+#include "display.h"
+
+#define SHARED_FRAME_MAGIC 0x42463843
+#define SHARED_FRAME_VERSION 1
+
+/*
+Type Declarations
+*/
+
+typedef struct {
+	/*
+	SHARED_FRAME_MAGIC and SHARED_FRAME_VERSION, set before the first frame.
+	*/
+	unsigned int Magic;
+	unsigned int Version;
+	/*
+	Odd while a frame is being written, bumped twice for every frame.
+	*/
+	unsigned int Sequence;
+	int IsHigh;
+	/*
+	Numbered from 1, 0 until the first frame is published.
+	*/
+	unsigned long long Frame;
+	unsigned short Keys;
+	Display Display;
+} SharedFrame;
+
+/*
+Function Declarations
+*/
+
+/*
+Creates or replaces the segment called name, such as "/chip8", and maps it for writing.
+Returns NULL if it could not be created.
+*/
+SharedFrame *
+sharedFrameCreate(const char *name);
+
+/*
+Maps an existing segment for reading.
+Returns NULL if there is none, or it is not a frame segment of this version.
+*/
+const SharedFrame *
+sharedFrameAttach(const char *name);
+
+/*
+Writes a frame.
+Only one process may publish to a segment.
+*/
+void
+sharedFramePublish(SharedFrame *shared, const Display *display, int isHigh, unsigned long long frame, unsigned short keys);
+
+/*
+Copies the latest frame out of shared into frame and keys.
+Returns its frame number.
+*/
+unsigned long long
+sharedFrameRead(const SharedFrame *shared, Frame *frame, unsigned short *keys);
+
+/*
+Unmaps the segment, and removes it when name is not NULL.
+*/
+void
+sharedFrameClose(const SharedFrame *shared, const char *name);
+
+#endif
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Checks every program in tests against its goldens with both engines, and the engines against each other.
+# Run from the top of the tree with golden and lockstep built there as in README.md.
+# A program name.ch8 is run with the input in name.in for 200 frames, and has goldens name.fast and name.cosmac for the two timing models.
+
+status=0
+
+for program in tests/*.ch8; do
+	name=${program%.ch8}
+
+	for timing in fast cosmac; do
+		for engine in switch table; do
+			if ! ./golden -s -n 200 -i "$name.in" -e "$engine" -t "$timing" "$program" "$name.$timing"; then
+				echo "$program: $engine engine with $timing timing does not match $name.$timing"
+				status=1
+			fi
+		done
+
+		if ! ./lockstep -n 200 -i "$name.in" -t "$timing" "$program"; then
+			status=1
+		fi
+	done
+done
+
+exit $status
@@ -0,0 +1,33 @@
+; Moves a box right while key 5 is held and down while key 8 is held,
+; and counts the moves in the corner with the font.
+start:	load v0, 28
+	load v1, 12
+	load v2, 5
+	load v3, 8
+	load i, box
+	draw v0, v1, 4
+	hex v5
+	draw v6, v6, 5
+loop:	load v4, 2
+	load time, v4
+wait:	load v4, time
+	skip.ne v4, 0
+	jump move
+	jump wait
+move:	load i, box
+	draw v0, v1, 4
+	skip.ne v2, key
+	add v0, 1
+	skip.ne v3, key
+	add v1, 1
+	draw v0, v1, 4
+	hex v5
+	draw v6, v6, 5
+	add v5, 1
+	load v7, 0x0F
+	and v5, v7
+	hex v5
+	draw v6, v6, 5
+	jump loop
+box:	data 0xF090
+	data 0x90F0
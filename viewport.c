@@ -0,0 +1,34 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+#include "viewport.h"
+
+/*
+Function Definitions
+*/
+
+void
+viewportInit(Viewport *viewport, int imageWidth, int imageHeight, int screenWidth, int screenHeight)
+{
+	viewport->ImageWidth = imageWidth;
+	viewport->ImageHeight = imageHeight;
+	viewportResize(viewport, screenWidth, screenHeight);
+}
+
+void
+viewportResize(Viewport *viewport, int screenWidth, int screenHeight)
+{
+	int scaleX = screenWidth / viewport->ImageWidth;
+	int scaleY = screenHeight / viewport->ImageHeight;
+
+	viewport->Scale = scaleX < scaleY ? scaleX : scaleY;
+	if (viewport->Scale < 1) {
+		viewport->Scale = 1;
+	}
+
+	viewport->Width = viewport->ImageWidth * viewport->Scale;
+	viewport->Height = viewport->ImageHeight * viewport->Scale;
+	viewport->X = (screenWidth - viewport->Width) / 2;
+	viewport->Y = (screenHeight - viewport->Height) / 2;
+}
@@ -0,0 +1,48 @@
+/*
+See LICENSE file for copyright and license details.
+*/
+
+/*
+Where the display is drawn in the window.
+The display is scaled by the largest whole number that fits and centered, leaving black bars on the sides that do not fit.
+Only recomputed when the window changes size.
+*/
+
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+/*
+Type Declarations
+*/
+
+typedef struct {
+	/*
+	Size of the image being drawn.
+	*/
+	int ImageWidth;
+	int ImageHeight;
+	int Scale;
+	/*
+	Scaled image rectangle in window coordinates.
+	*/
+	int X;
+	int Y;
+	int Width;
+	int Height;
+} Viewport;
+
+/*
+Function Declarations
+*/
+
+void
+viewportInit(Viewport *viewport, int imageWidth, int imageHeight, int screenWidth, int screenHeight);
+
+/*
+Fits the image to a window of the new size.
+A window smaller than the image still draws it at scale 1, cut off at the edges.
+*/
+void
+viewportResize(Viewport *viewport, int screenWidth, int screenHeight);
+
+#endif